@@ -0,0 +1,519 @@
+/** @file benchmain.cpp
+
+    @brief Benchmarks for the interpreter engines and the genetic algorithm
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+
+#include <sys/resource.h>
+
+#include "brainf.h"
+#include "brainfbatch.h"
+#include "genepool.h"
+#include "brainfgene.h"
+
+namespace {
+
+struct Program
+{
+    std::string name, code, input;
+    /** Step limit per run, 0 for unlimited */
+    size_t maxSteps;
+};
+
+/** Some programs from main.cpp and some classic heavier ones */
+std::vector<Program> builtinPrograms()
+{
+    std::vector<Program> p;
+
+    p.push_back({ "hello",
+        "++++++++[>++++[>++>+++>+++>+<<<<-]>+>+>->>+[<]<-]>>.>---.+++++++..+++.>>.<-.<.+++.------.--------.>>+.>++.",
+        "", 0 });
+
+    p.push_back({ "hello2",
+        ">++++++++[<+++++++++>-]<.>>+>+>++>[-]+<[>[->+<<++++>]<<]>.+++++++..+++.>>+++++++.<<<[[-]<[-]>]<+++++++++++++++.>>.+++.------.--------.>>+.>++++.",
+        "", 0 });
+
+    p.push_back({ "hello-flat",
+        "++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.+++++++++++++++++++++++++++++.+++++++..+++.-------------------------------------------------------------------------------.+++++++++++++++++++++++++++++++++++++++++++++++++++++++.++++++++++++++++++++++++.+++.------.--------.-------------------------------------.",
+        "", 0 });
+
+    // http://esoteric.sange.fi/brainfuck/bf-source/prog/fibonacci.txt
+    p.push_back({ "fibonacci",
+        "+++++++++++"
+        ">+>>>>++++++++++++++++++++++++++++++++++++++++++++"
+        ">++++++++++++++++++++++++++++++++<<<<<<[>[>>>>>>+>"
+        "+<<<<<<<-]>>>>>>>[<<<<<<<+>>>>>>>-]<[>++++++++++[-"
+        "<-[>>+>+<<<-]>>>[<<<+>>>-]+<[>[-]<[-]]>[<<[>>>+<<<"
+        "-]>>[-]]<<]>>>[>>+>+<<<-]>>>[<<<+>>>-]+<[>[-]<[-]]"
+        ">[<<+>>[-]]<<<<<<<]>>>>>[+++++++++++++++++++++++++"
+        "+++++++++++++++++++++++.[-]]++++++++++<[->-<]>++++"
+        "++++++++++++++++++++++++++++++++++++++++++++.[-]<<"
+        "<<<<<<<<<<[>>>+>+<<<<-]>>>>[<<<<+>>>>-]<-[>>.>.<<<"
+        "[-]]<<[>>+>+<<<-]>>>[<<<+>>>-]<<[<+>-]>[<+>-]<<<-]",
+        "", 0 });
+
+    p.push_back({ "ascii-to-decimal",
+        ">++++++++[<++++>-]"
+        ",["
+        ">>++++++++++<<[->+>-[>+>>]>[+[-<+>]>+>>]<<<<<<]>>[-]>>>++++++++++<[->-[>+>>]>[+[-"
+        "<+>]>+>>]<<<<<]>[-]>>[>++++++[-<++++++++>]<.<<+>+>[-]]<[<[->-<]++++++[->++++++++"
+        "<]>.[-]]<<++++++[-<++++++++>]<.[-]<<[-<+>]<"
+        "<.>"
+        ",]",
+        "The quick brown fox jumps over the lazy dog", 0 });
+
+    // squares 0 to 10000, Daniel B. Cristofani
+    p.push_back({ "squares",
+        "++++[>+++++<-]>[<+++++>-]+<+[>[>+>+<<-]++>>[<<+>>-]>>>[-]++>[-]+>>>+[[-]++++++>>>]<<<"
+        "[[<++++++++<++>>-]+<.<[>----<-]<]<<[>>>>>[>>>[-]+++++++++<[>-<-]+++++++++>[-[<->-]+[<<<]]"
+        "<[>+<-]>]<<-]<<-]",
+        "", 0 });
+
+    // four nested counters, about a million inner iterations
+    const std::string c32(32, '+');
+    p.push_back({ "nested-counters",
+        c32 + "[>" + c32 + "[>" + c32 + "[>" + c32 + "[>+<-]<-]<-]<-]",
+        "", 0 });
+
+    // multiplications in nested loops, mandelbrot-style arithmetic
+    p.push_back({ "multiply",
+        std::string(200, '+')
+        + "[>++++++++[>++++++++[>+>+<<-]>>[<<+>>-]<<<-]>[-]>[-]<<<-]",
+        "", 0 });
+
+    return p;
+}
+
+/** Creates a corpus of genes as produced by the genetic algorithm */
+std::vector<Program> geneCorpus(size_t num, size_t generations)
+{
+    GenePool pool;
+    pool.setSeed(23);
+
+    std::vector<Gene*> genes;
+    for (size_t i=0; i<num; ++i)
+        genes.push_back( new BrainfGene() );
+    pool.initialize(genes);
+    pool.evaluate();
+    for (size_t i=0; i<generations; ++i)
+    {
+        pool.nextGeneration();
+        pool.evaluate();
+    }
+
+    std::vector<Program> p;
+    for (auto & g : pool.genes())
+    {
+        auto bg = static_cast<BrainfGene*>(g.get());
+        p.push_back({ "", bg->getBrainf().codeString(),
+                      bg->getBrainf().inputString(), bg->maxSteps() });
+    }
+    return p;
+}
+
+double now()
+{
+    return std::chrono::duration<double>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Returns peak resident set size in kilobytes */
+long peakRss()
+{
+    struct rusage u;
+    if (getrusage(RUSAGE_SELF, &u) != 0)
+        return 0;
+    return u.ru_maxrss;
+}
+
+std::string jsonString(const std::string& s)
+{
+    std::string r = "\"";
+    for (char c : s)
+    {
+        switch (c)
+        {
+            case '"': r += "\\\""; break;
+            case '\\': r += "\\\\"; break;
+            case '\n': r += "\\n"; break;
+            default:
+                if ((unsigned char)c < 32)
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    r += buf;
+                }
+                else
+                    r += c;
+        }
+    }
+    return r + "\"";
+}
+
+struct Result
+{
+    std::string program, cell, engine;
+    size_t programs, opcodes, steps, runs;
+    double seconds;
+};
+
+struct BatchResult
+{
+    size_t threads, jobs, steps, runs;
+    double seconds;
+};
+
+struct Settings
+{
+    Settings() : minTime(0.1), population(200), generations(100),
+                 corpusSize(500), runInterpreter(true), runGa(true),
+                 runBatch(true) { }
+    double minTime;
+    size_t population, generations, corpusSize;
+    bool runInterpreter, runGa, runBatch;
+    std::vector<std::string> cells;
+};
+
+/** Runs all @p progs once, returns the number of steps */
+template <typename T>
+size_t runOnce(const std::vector<Program>& progs, BrainfEngine engine)
+{
+    size_t steps = 0;
+    for (auto & p : progs)
+    {
+        Brainf<T> bf;
+        bf.setEngine(engine);
+        bf.setCode(p.code);
+        bf.setInput(p.input);
+        steps += bf.run(p.maxSteps).steps;
+    }
+    return steps;
+}
+
+template <typename T>
+void benchCell(const char * cell, const std::vector<std::vector<Program>>& sets,
+               const std::vector<std::string>& names,
+               const Settings& set, std::vector<Result>& results)
+{
+    if (!set.cells.empty()
+        && std::find(set.cells.begin(), set.cells.end(), cell) == set.cells.end())
+        return;
+
+    for (size_t i=0; i<sets.size(); ++i)
+    for (int e = 0; e < BFE_NUM; ++e)
+    {
+        Result r;
+        r.program = names[i];
+        r.cell = cell;
+        r.engine = brainfEngineName(BrainfEngine(e));
+        r.programs = sets[i].size();
+        r.opcodes = 0;
+        for (auto & p : sets[i])
+            r.opcodes += Brainf<T>::parseCode(p.code).size();
+        r.steps = r.runs = 0;
+
+        // repeat until minimum time is reached
+        const double start = now();
+        do
+        {
+            r.steps += runOnce<T>(sets[i], BrainfEngine(e));
+            ++r.runs;
+            r.seconds = now() - start;
+        }
+        while (r.seconds < set.minTime);
+
+        std::cerr << std::setw(18) << r.program << std::setw(12) << r.cell
+                  << std::setw(11) << r.engine
+                  << std::setw(10) << std::fixed << std::setprecision(2)
+                  << (r.seconds * 1e9 / std::max(size_t(1), r.steps)) << " ns/op"
+                  << std::endl;
+        results.push_back(r);
+    }
+}
+
+/** Runs @p progs through BrainfBatch with 1, 2, 4, .. threads
+    up to the number of cores */
+void benchBatch(const std::vector<Program>& progs, const Settings& set,
+                std::vector<BatchResult>& results)
+{
+    std::vector<BrainfBatch<u_int8_t>::Job> jobs;
+    for (auto & p : progs)
+        jobs.push_back({ p.code, p.input, p.maxSteps });
+
+    BrainfBatch<u_int8_t> batch;
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; ; threads = std::min(threads * 2, cores))
+    {
+        batch.setNumThreads(threads);
+        BatchResult r;
+        r.threads = threads;
+        r.jobs = jobs.size();
+        r.steps = r.runs = 0;
+
+        const double start = now();
+        do
+        {
+            r.steps += batch.run(jobs);
+            ++r.runs;
+            r.seconds = now() - start;
+        }
+        while (r.seconds < set.minTime);
+
+        std::cerr << "batch " << std::setw(4) << threads << " threads"
+                  << std::setw(14) << std::fixed << std::setprecision(0)
+                  << (r.jobs * r.runs / std::max(r.seconds, 1e-9)) << " jobs/sec"
+                  << std::endl;
+        results.push_back(r);
+
+        if (threads == cores)
+            break;
+    }
+}
+
+void printUsage(std::ostream& out)
+{
+    out <<
+    "usage: brainf-bench [options] [file.bf ...]\n"
+    "\n"
+    "Benchmarks the interpreter engines for all cell types and\n"
+    "the genetic algorithm, and prints the results as JSON.\n"
+    "Additional programs can be given as files.\n"
+    "\n"
+    "  -o, --out FILE        write JSON to FILE instead of stdout\n"
+    "  -t, --time SEC        minimum time per measurement (default 0.1)\n"
+    "  -c, --cell TYPE       only benchmark this cell type (can be repeated)\n"
+    "      --population N    genes in GA benchmark (default 200)\n"
+    "      --generations N   generations in GA benchmark (default 100)\n"
+    "      --corpus N        genes in the evolved gene corpus (default 500)\n"
+    "      --no-ga           skip GA benchmark\n"
+    "      --no-interpreter  skip interpreter benchmarks\n"
+    "      --no-batch        skip the threaded batch benchmark\n"
+    "  -h, --help            show this help\n";
+}
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+    Settings set;
+    std::string outFile;
+    std::vector<Program> progs = builtinPrograms();
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+        const bool hasArg = i + 1 < argc;
+
+        if (a == "-h" || a == "--help")
+        {
+            printUsage(std::cout);
+            return 0;
+        }
+        else if ((a == "-o" || a == "--out") && hasArg)
+            outFile = argv[++i];
+        else if ((a == "-t" || a == "--time") && hasArg)
+            set.minTime = std::strtod(argv[++i], 0);
+        else if ((a == "-c" || a == "--cell") && hasArg)
+            set.cells.push_back(argv[++i]);
+        else if (a == "--population" && hasArg)
+            set.population = std::strtoull(argv[++i], 0, 10);
+        else if (a == "--generations" && hasArg)
+            set.generations = std::strtoull(argv[++i], 0, 10);
+        else if (a == "--corpus" && hasArg)
+            set.corpusSize = std::strtoull(argv[++i], 0, 10);
+        else if (a == "--no-ga")
+            set.runGa = false;
+        else if (a == "--no-interpreter")
+            set.runInterpreter = false;
+        else if (a == "--no-batch")
+            set.runBatch = false;
+        else if (a.size() > 1 && a[0] == '-')
+        {
+            std::cerr << "unknown option or missing argument '" << a << "'" << std::endl;
+            printUsage(std::cerr);
+            return 2;
+        }
+        else
+        {
+            std::ifstream f(a, std::ios::binary);
+            if (!f)
+            {
+                std::cerr << "can not read '" << a << "'" << std::endl;
+                return 1;
+            }
+            std::stringstream s;
+            s << f.rdbuf();
+            progs.push_back({ a, s.str(), "", 0 });
+        }
+    }
+
+    std::vector<Result> results;
+    std::vector<BatchResult> batchResults;
+    std::vector<Program> corpus;
+    if (set.runInterpreter || set.runBatch)
+        corpus = geneCorpus(set.corpusSize, 50);
+
+    if (set.runInterpreter)
+    {
+        // each program is one set, the gene corpus is another
+        std::vector<std::vector<Program>> sets;
+        std::vector<std::string> names;
+        for (auto & p : progs)
+        {
+            sets.push_back({ p });
+            names.push_back(p.name);
+        }
+        sets.push_back(corpus);
+        names.push_back("gene-corpus");
+
+        benchCell<u_int8_t>                     ("uint8", sets, names, set, results);
+        benchCell<int8_t>                       ("int8", sets, names, set, results);
+        benchCell<u_int16_t>                    ("uint16", sets, names, set, results);
+        benchCell<int16_t>                      ("int16", sets, names, set, results);
+        benchCell<u_int32_t>                    ("uint32", sets, names, set, results);
+        benchCell<int32_t>                      ("int32", sets, names, set, results);
+        benchCell<u_int64_t>                    ("uint64", sets, names, set, results);
+        benchCell<int64_t>                      ("int64", sets, names, set, results);
+        benchCell<Brainf_saturated<u_int8_t>>   ("uint8_sat", sets, names, set, results);
+        benchCell<Brainf_saturated<int8_t>>     ("int8_sat", sets, names, set, results);
+        benchCell<Brainf_saturated<u_int16_t>>  ("uint16_sat", sets, names, set, results);
+        benchCell<Brainf_saturated<int16_t>>    ("int16_sat", sets, names, set, results);
+        benchCell<Brainf_saturated<u_int32_t>>  ("uint32_sat", sets, names, set, results);
+        benchCell<Brainf_saturated<int32_t>>    ("int32_sat", sets, names, set, results);
+        benchCell<Brainf_saturated<u_int64_t>>  ("uint64_sat", sets, names, set, results);
+        benchCell<Brainf_saturated<int64_t>>    ("int64_sat", sets, names, set, results);
+        benchCell<Brainf_bignum>                ("big", sets, names, set, results);
+    }
+
+    // the gene corpus on all cores
+    if (set.runBatch)
+        benchBatch(corpus, set, batchResults);
+
+    // genetic algorithm throughput
+    double evalTime = 0., nextTime = 0.;
+    uint64_t evals = 0, cacheHits = 0;
+    if (set.runGa && set.population > 0)
+    {
+        GenePool pool;
+        pool.setSeed(42);
+        std::vector<Gene*> genes;
+        for (size_t i=0; i<set.population; ++i)
+            genes.push_back( new BrainfGene() );
+        pool.initialize(genes);
+
+        // the genes that were actually evaluated, not the cached ones
+        const uint64_t firstEval = pool.numEvaluations(),
+                       firstHits = pool.numCacheHits();
+        for (size_t i=0; i<set.generations; ++i)
+        {
+            double t = now();
+            pool.evaluate();
+            evalTime += now() - t;
+
+            t = now();
+            pool.nextGeneration();
+            nextTime += now() - t;
+        }
+        evals = pool.numEvaluations() - firstEval;
+        cacheHits = pool.numCacheHits() - firstHits;
+        std::cerr << "GA: " << evals / std::max(evalTime, 1e-9) << " evaluations/sec, "
+                  << set.generations / std::max(evalTime + nextTime, 1e-9)
+                  << " generations/sec" << std::endl;
+    }
+
+    // --- json ---
+
+    std::ofstream fout;
+    if (!outFile.empty())
+    {
+        fout.open(outFile);
+        if (!fout)
+        {
+            std::cerr << "can not write '" << outFile << "'" << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = outFile.empty() ? std::cout : fout;
+    out << std::setprecision(6);
+
+    out << "{\n"
+        << "  \"benchmark\": \"brainf\",\n"
+        << "  \"version\": 1,\n"
+        << "  \"timestamp\": " << std::time(0) << ",\n"
+        << "  \"min_time\": " << set.minTime << ",\n"
+        << "  \"interpreter\": [";
+    for (size_t i=0; i<results.size(); ++i)
+    {
+        const Result& r = results[i];
+        const double steps = std::max(size_t(1), r.steps);
+        out << (i ? ",\n" : "\n")
+            << "    { \"program\": " << jsonString(r.program)
+            << ", \"cell\": " << jsonString(r.cell)
+            << ", \"engine\": " << jsonString(r.engine)
+            << ", \"programs\": " << r.programs
+            << ", \"opcodes\": " << r.opcodes
+            << ", \"runs\": " << r.runs
+            << ", \"steps\": " << r.steps
+            << ", \"seconds\": " << r.seconds
+            << ", \"ops_per_sec\": " << r.steps / std::max(r.seconds, 1e-9)
+            << ", \"ns_per_op\": " << r.seconds * 1e9 / steps
+            << " }";
+    }
+    out << "\n  ],\n";
+
+    if (set.runBatch)
+    {
+        out << "  \"batch\": [";
+        for (size_t i=0; i<batchResults.size(); ++i)
+        {
+            const BatchResult& r = batchResults[i];
+            out << (i ? ",\n" : "\n")
+                << "    { \"threads\": " << r.threads
+                << ", \"jobs\": " << r.jobs
+                << ", \"runs\": " << r.runs
+                << ", \"steps\": " << r.steps
+                << ", \"seconds\": " << r.seconds
+                << ", \"jobs_per_sec\": " << r.jobs * r.runs / std::max(r.seconds, 1e-9)
+                << ", \"ops_per_sec\": " << r.steps / std::max(r.seconds, 1e-9)
+                << " }";
+        }
+        out << "\n  ],\n";
+    }
+
+    if (set.runGa)
+        out << "  \"ga\": {"
+            << " \"population\": " << set.population
+            << ", \"generations\": " << set.generations
+            << ", \"evaluations\": " << evals
+            << ", \"cache_hits\": " << cacheHits
+            << ", \"evaluate_seconds\": " << evalTime
+            << ", \"next_generation_seconds\": " << nextTime
+            << ", \"evaluations_per_sec\": " << evals / std::max(evalTime, 1e-9)
+            << ", \"next_generations_per_sec\": " << set.generations / std::max(nextTime, 1e-9)
+            << ", \"generations_per_sec\": " << set.generations / std::max(evalTime + nextTime, 1e-9)
+            << " },\n";
+
+    out << "  \"peak_rss_kb\": " << peakRss() << "\n"
+        << "}\n";
+
+    return 0;
+}
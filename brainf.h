@@ -30,8 +30,13 @@
 */
 
 #include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
 #include <vector>
 #include <string>
+#include <memory>
+#include <type_traits>
 
 #ifndef SRC_BRAINF_H_INCLUDED
 #define SRC_BRAINF_H_INCLUDED
@@ -54,19 +59,197 @@ enum BrainfOpcode
 enum BrainfFlags
 {
     BFF_EXPAND_LEFT = 1,
-    BFF_EXPAND_RIGHT = 2
+    BFF_EXPAND_RIGHT = 2,
+    /** Stop run() when entering a loop that provably never terminates
+        and does not output anything (see BrainfAnalysis) */
+    BFF_STOP_INFINITE = 4,
+    /** Stop run() at an input opcode when all input is consumed,
+        instead of reading 0. More input can be added with appendInput()
+        and the program resumed with run(). */
+    BFF_WAIT_INPUT = 8
 };
 
+/** The execution engines of the Brainf class */
+enum BrainfEngine
+{
+    /** Plain switch statement, matching brackets are searched
+        on each encounter */
+    BFE_REFERENCE,
+    /** Switch statement with a look-up table for matching brackets */
+    BFE_JUMPTABLE,
+    /** Like BFE_JUMPTABLE, but loops that BrainfAnalysis marks as affine
+        are run in closed form, as far as the step limit allows */
+    BFE_OPTIMIZED,
+    /** Number of engines */
+    BFE_NUM
+};
+
+/** Returns a short name for the engine, e.g. "jumptable" */
+inline const char * brainfEngineName(BrainfEngine e)
+{
+    switch (e)
+    {
+        case BFE_REFERENCE: return "reference";
+        case BFE_JUMPTABLE: return "jumptable";
+        case BFE_OPTIMIZED: return "optimized";
+        default: return "unknown";
+    }
+}
+
+/** Returns the engine for the name as returned by brainfEngineName(),
+    or BFE_NUM if unknown */
+inline BrainfEngine brainfEngineFromName(const std::string& name)
+{
+    for (int i = 0; i < BFE_NUM; ++i)
+        if (name == brainfEngineName(BrainfEngine(i)))
+            return BrainfEngine(i);
+    return BFE_NUM;
+}
+
+/** Why Brainf::run() returned */
+enum BrainfRunStatus
+{
+    /** The program counter moved past the last opcode */
+    BFR_FINISHED,
+    /** The step limit was reached */
+    BFR_STEP_LIMIT,
+    /** Stopped at the '[' of an infinite loop (with BFF_STOP_INFINITE) */
+    BFR_INFINITE,
+    /** Stopped at a ',' without input (with BFF_WAIT_INPUT) */
+    BFR_WAIT_INPUT,
+    /** The code has unmatched brackets and was not run.
+        Brainf::run() runs such code, where unmatched brackets
+        never jump, this is for callers that reject it. */
+    BFR_UNBALANCED
+};
+
+/** Returns a short name for the status, e.g. "step-limit" */
+inline const char * brainfRunStatusName(BrainfRunStatus s)
+{
+    switch (s)
+    {
+        case BFR_FINISHED: return "finished";
+        case BFR_STEP_LIMIT: return "step-limit";
+        case BFR_INFINITE: return "infinite";
+        case BFR_WAIT_INPUT: return "wait-input";
+        case BFR_UNBALANCED: return "unbalanced";
+        default: return "unknown";
+    }
+}
+
+/** The result of Brainf::run() */
+struct BrainfRunResult
+{
+    BrainfRunStatus status;
+    /** Number of processed opcodes */
+    size_t steps;
+    /** The tape range after the run, Brainf::tapeBegin() and
+        Brainf::tapeEnd(). The range never shrinks while running,
+        so this is the largest extent so far. */
+    std::ptrdiff_t tapeBegin, tapeEnd;
+};
+
+#include "brainfanalysis.h"
+#include "brainfprofile.h"
+
 /** A traits class to convert the internal type of the Brainf class
-    to/from char and to signed integer.
+    to/from char and to signed integer, and to define the cell arithmetic.
     Generally there should be no need to specialize it, unless
-    you want to use >64 bit or map characters differently. */
+    you want to use >64 bit or map characters differently.
+    The default counts integral types in their unsigned counterpart,
+    so they wrap around without any extra branching, and signed types
+    do that without overflow. Other types use their plain operators. */
 template <typename T>
 struct Brainf_traits
 {
+    /** The type that inc() and dec() count in */
+    typedef typename std::conditional<std::is_integral<T>::value,
+                                      std::make_unsigned<T>,
+                                      std::common_type<T>>::type::type U;
+
     static char toChar(T v) { return v; }
     static T fromChar(char c) { return c; }
     static int64_t toNumber(T v) { return v; }
+    static std::string toString(T v) { return std::to_string(v); }
+
+    static bool isZero(T v) { return v == T(0); }
+    static void inc(T& v) { v = T(U(v) + U(1)); }
+    static void dec(T& v) { v = T(U(v) - U(1)); }
+
+    /** The cells wrap around at 2^bits, so BFE_OPTIMIZED can compute
+        the effect of many increments with toBits() and fromBits().
+        0 for cell types that do not wrap. */
+    static const int bits = std::numeric_limits<T>::is_integer
+                            && sizeof(T) <= 8 ? int(sizeof(T)) * 8 : 0;
+    static uint64_t toBits(T v) { return uint64_t(v); }
+    static T fromBits(uint64_t b) { return T(b); }
+};
+
+
+/** A cell type with saturating arithmetic.
+    Wraps the integral type @p T. Increments and decrements
+    stop at the numeric limits instead of wrapping around. */
+template <typename T>
+struct Brainf_saturated
+{
+    Brainf_saturated(T v = 0) : v(v) { }
+    bool operator == (const Brainf_saturated& o) const { return v == o.v; }
+    bool operator != (const Brainf_saturated& o) const { return v != o.v; }
+    T v;
+};
+
+template <typename T>
+struct Brainf_traits<Brainf_saturated<T>>
+{
+    typedef Brainf_saturated<T> C;
+
+    static char toChar(C v) { return v.v; }
+    static C fromChar(char c) { return C(T(c)); }
+    static int64_t toNumber(C v) { return v.v; }
+    static std::string toString(C v) { return std::to_string(v.v); }
+
+    static bool isZero(C v) { return v.v == T(0); }
+    // branch-free: adds 0 when at the limit
+    static void inc(C& v) { v.v = T(v.v + T(v.v != std::numeric_limits<T>::max())); }
+    static void dec(C& v) { v.v = T(v.v - T(v.v != std::numeric_limits<T>::min())); }
+
+    static const int bits = 0;
+    static uint64_t toBits(C v) { return uint64_t(v.v); }
+    static C fromBits(uint64_t b) { return C(T(b)); }
+};
+
+
+/** A 128 bit signed cell type ("bignum-lite").
+    Large enough that numeric programs practically never overflow,
+    while still being a fixed-size value. Wraps around at 2^128. */
+struct Brainf_bignum
+{
+    Brainf_bignum(int64_t v = 0) : lo(uint64_t(v)), hi(v < 0 ? -1 : 0) { }
+    bool operator == (const Brainf_bignum& o) const { return lo == o.lo && hi == o.hi; }
+    bool operator != (const Brainf_bignum& o) const { return !(*this == o); }
+    uint64_t lo;
+    int64_t hi;
+};
+
+template <>
+struct Brainf_traits<Brainf_bignum>
+{
+    typedef Brainf_bignum C;
+
+    static char toChar(C v) { return char(v.lo); }
+    static C fromChar(char c) { return C(c); }
+    /** Returns the lower 64 bits */
+    static int64_t toNumber(C v) { return int64_t(v.lo); }
+    static std::string toString(C v);
+
+    static bool isZero(C v) { return (v.lo | uint64_t(v.hi)) == 0; }
+    static void inc(C& v) { ++v.lo; v.hi += (v.lo == 0); }
+    static void dec(C& v) { v.hi -= (v.lo == 0); --v.lo; }
+
+    /** Wraps at 2^128, which is out of reach for toBits() */
+    static const int bits = 0;
+    static uint64_t toBits(C v) { return v.lo; }
+    static C fromBits(uint64_t b) { return C(int64_t(b)); }
 };
 
 
@@ -76,9 +259,24 @@ struct Brainf_traits
     The type @p T represents the type for cells (tape, input and output).
 
     Ascii programs get translated to BrainfOpcode before execution.
-    The interpreter currently does not use function pointers but a plain switch statement.
-    Also, the matching loop brackets are resolved on each encounter,
-    this could be much speed-up with a look-up table.
+    The interpreter does not use function pointers but a plain switch statement.
+    The BrainfEngine selects how the matching loop brackets are resolved,
+    either on each encounter or with a look-up table, and whether
+    loops are run in closed form.
+    All engines have the same semantics, down to the number of steps
+    and the state after a step limit. Unmatched brackets never jump.
+
+    The tape is a range of positions that grows with BFF_EXPAND_RIGHT and
+    BFF_EXPAND_LEFT. While it is smaller than maxDenseTape() it is kept
+    in one vector that grows geometrically in both directions. A larger
+    tape is split into pages of TAPE_PAGE_SIZE cells that are only
+    allocated when touched, so a program that strides far uses memory
+    for the cells it visits and not for the whole range.
+
+    The state can be saved with snapshot() and returned to with restore().
+    The tape of a snapshot is split into pages that are shared with the
+    interpreter and other snapshots. The interpreter marks the pages it
+    writes to, so only those are copied on the next snapshot() or restore().
 */
 template <typename T>
 class Brainf
@@ -88,6 +286,26 @@ public:
     /** Signed index type */
     typedef std::ptrdiff_t Index;
 
+    /** Number of cells in a page of the sparse tape and of a Snapshot */
+    static const size_t TAPE_PAGE_SIZE = 1024;
+
+    /** Default for setMaxDenseTape() */
+    static const size_t DEFAULT_MAX_DENSE_TAPE = 1 << 20;
+
+    /** The state of the interpreter, see snapshot().
+        The code and input are not part of it, and of the output
+        only the length. */
+    struct Snapshot
+    {
+        Index codePos, codeHighWater, inputPos, tapePos, tapeBegin, tapeEnd;
+        size_t outputSize;
+        /** The tape in pages of TAPE_PAGE_SIZE cells, which are never
+            changed once created. Pages that were never touched are null.
+            pages[0] starts at tape position pageBegin * TAPE_PAGE_SIZE. */
+        std::vector<std::shared_ptr<const std::vector<T>>> pages;
+        Index pageBegin;
+    };
+
     /** Constructs a brainfuck engine.
         @p tapeLength is the initial positive length of the internal tape.
         @p tapeLengthNeg is the initial negative length of the internal tape.
@@ -96,6 +314,8 @@ public:
                     Index tapeLengthNeg = 16,
                     int flags = BFF_EXPAND_RIGHT)
         : p_flags_(flags)
+        , p_engine_(BFE_REFERENCE)
+        , p_maxDense_(DEFAULT_MAX_DENSE_TAPE)
     { clear(tapeLength, tapeLengthNeg); }
 
     // ---------------- getter -------------------
@@ -103,6 +323,9 @@ public:
     /** Returns the set flags (or-combination of BrainfFlags) */
     int flags() const { return p_flags_; }
 
+    /** Returns the execution engine */
+    BrainfEngine engine() const { return p_engine_; }
+
     /** Returns read access to the code (in BrainfOpcode format) */
     const std::vector<BrainfOpcode>& code() const { return p_code_; }
 
@@ -112,8 +335,28 @@ public:
     /** Returns read access to the output of the program */
     const std::vector<T>& output() const { return p_out_; }
 
-    /** Returns read access to the tape */
-    const std::vector<T>& tape() const { return p_tape_; }
+    /** Returns a copy of the tape from tapeBegin() to tapeEnd().
+        For a sparse tape that spans a large range, cell() is cheaper. */
+    std::vector<T> tape() const;
+
+    /** Returns the value at tape position @p pos,
+        0 for cells that were never written or are outside of the tape */
+    T cell(Index pos) const;
+
+    /** Returns the first position of the tape */
+    Index tapeBegin() const { return p_tape_lo_; }
+
+    /** Returns the position behind the last cell of the tape */
+    Index tapeEnd() const { return p_tape_hi_; }
+
+    /** Returns true when the tape is kept in pages, see maxDenseTape() */
+    bool isTapeSparse() const { return p_sparse_; }
+
+    /** Returns the number of cells that are allocated for the tape */
+    size_t tapeMemory() const;
+
+    /** Returns the number of cells up to which the tape is kept in one vector */
+    size_t maxDenseTape() const { return p_maxDense_; }
 
     /** Returns the current position of the program counter. */
     Index programPosition() const { return p_code_p_; }
@@ -125,6 +368,26 @@ public:
     /** Returns the current position in the input */
     Index inputPosition() const { return p_in_p_; }
 
+    /** Returns the index of tape position 0 in tape() */
+    Index tapeOffset() const { return -p_tape_lo_; }
+
+    /** Returns the highest code position that the program executed
+        since the last setCode(), or -1 if nothing has been executed.
+        A skipped loop counts as executed up to its ']'.
+        All opcodes before this position are the only ones that
+        influenced the current state, so code after it can be
+        changed with replaceCode() without invalidating the state,
+        unless the change gives a '[' before it a matching bracket
+        that it did not have, or takes it away. An unmatched '['
+        does not jump, so it may have run differently. */
+    Index maxExecutedPosition() const { return std::max(p_code_hw_, p_code_p_ - 1); }
+
+    /** Returns true when the program stopped at an input opcode
+        because of BFF_WAIT_INPUT and missing input. */
+    bool isWaitingForInput() const
+        { return p_code_p_ < Index(p_code_.size()) && p_code_[p_code_p_] == BFO_IN
+                 && p_in_p_ >= Index(p_in_.size()); }
+
     // ------------ string conversion ------------
 
     /** Returns the current program as ascii representation (<>+-.,[]).
@@ -151,10 +414,10 @@ public:
     /** Returns the tape as std::string.
         If @p ignore_control is true, only characters 32-127 are included. */
     std::string tapeString(bool ignore_control = false) const
-        { return toString(p_tape_, ignore_control); }
+        { return toString(tape(), ignore_control); }
 
     /** Returns the tape as std::string with a number of each entry. */
-    std::string tapeStringNum() const { return toStringNum(p_tape_); }
+    std::string tapeStringNum() const { return toStringNum(tape()); }
 
     // ---------------- setter -------------------
 
@@ -166,13 +429,30 @@ public:
     /** Sets the interpreter flags (or-combination of BrainfFlags) */
     void setFlags(int flags) { p_flags_ = flags; }
 
+    /** Sets the execution engine */
+    void setEngine(BrainfEngine e) { p_engine_ = e; }
+
+    /** Sets the number of cells up to which the tape is kept in one
+        vector, a larger tape is switched to pages. A tape that is already
+        sparse stays sparse until clear() or setTape(). */
+    void setMaxDenseTape(size_t cells) { p_maxDense_ = cells; }
+
     /** Sets the code from the ascii representation (<>+-.,[]).
         Resets the program counter. */
     void setCode(const std::string& s);
 
     /** Sets the code directly from the opcodes given in @p code.
         Resets the program counter. */
-    void setCode(const std::vector<BrainfOpcode>& code) { p_code_ = code; p_code_p_ = 0; }
+    void setCode(const std::vector<BrainfOpcode>& code)
+        { p_code_ = code; p_code_p_ = 0; p_code_hw_ = -1; p_stall_.clear(); p_jump_.clear(); p_loopAt_.clear(); }
+
+    /** Replaces @p count opcodes at position @p pos with @p code.
+        The program state is kept, a program counter behind the replaced
+        range is moved along with the code and one inside is set to @p pos,
+        so code inserted right at the program counter is executed next.
+        A jump table that is already built is patched instead of
+        recomputed when no brackets are inserted or removed. */
+    void replaceCode(Index pos, Index count, const std::vector<BrainfOpcode>& code);
 
     /** Sets the input to use on next run().
         The input position is reset to 0. */
@@ -182,18 +462,72 @@ public:
         The input position is reset to 0. */
     void setInput(const std::vector<T>& input) { p_in_ = input; p_in_p_ = 0; }
 
+    /** Sets the position in the input, e.g. after setInput()
+        to continue a program with changed input. */
+    void setInputPosition(Index pos) { p_in_p_ = pos; }
+
+    /** Appends to the input, e.g. to feed a program waiting with BFF_WAIT_INPUT.
+        Input that has already been read is discarded, so the input
+        position restarts at 0 for the remaining input. */
+    void appendInput(const std::vector<T>& input);
+
+    /** Appends characters to the input, see appendInput(const std::vector<T>&) */
+    void appendInput(const std::string& input) { appendInput(fromString(input)); }
+
+    /** Clears the output, e.g. after it has been processed */
+    void clearOutput() { p_out_.clear(); }
+
+    /** Shortens the output to @p length values */
+    void truncateOutput(size_t length) { if (length < p_out_.size()) p_out_.resize(length); }
+
+    /** Moves the program counter, e.g. to undo a step */
+    void setProgramPosition(Index pos) { p_code_p_ = pos; }
+
+    /** Moves the tape position, e.g. to undo a step */
+    void setTapePosition(Index pos) { p_tape_p_ = pos; }
+
     /** Sets the contents of the tape.
         The tape position is reset to 0 and the tape will start at 0
         (e.g. no negative expansion) */
-    void setTape(const std::vector<T>& tape) { p_tape_ = tape; p_tape_p_ = p_tape_0_ = 0; }
+    void setTape(const std::vector<T>& tape);
 
     // -------------- execute --------------------
 
     /** Runs the program.
         The execution stops, when the program counter moves past the last
         opcode, or when @p max_steps != 0 and the number of processed opcodes
-        equals @p max_steps. */
-    void run(size_t max_steps = 0);
+        equals @p max_steps.
+        With BFF_STOP_INFINITE, execution also stops at the '[' of a loop
+        that would never terminate, with BFF_WAIT_INPUT it stops at the ','
+        when there is no more input.
+        run() can be called again to continue the program.
+        Returns why it stopped and the number of processed opcodes. */
+    BrainfRunResult run(size_t max_steps = 0);
+
+    /** Runs the program like run(size_t) and collects execution counters
+        into @p profile. This is slower than the normal run(), which does
+        no profiling at all. */
+    BrainfRunResult run(size_t max_steps, BrainfProfile& profile);
+
+    /** Builds the jump table and loop analysis needed by the engine and flags.
+        run() does this on demand, this is for keeping a prepared copy. */
+    void compile();
+
+    // -------------- snapshots ------------------
+
+    /** Returns the current state of program counter, tape, input position
+        and output length. Only the tape pages that were written since the
+        last snapshot() or restore() are copied, the others are shared. */
+    Snapshot snapshot();
+
+    /** Returns to the state in @p s, which may come from any interpreter
+        with the same cell type. Only the tape pages that differ from @p s
+        are copied. The code and input are left as they are, so the
+        snapshot should come from the same code, or from code that only
+        changed behind maxExecutedPosition(), and the same input.
+        The output is shortened to the length at the snapshot, output that
+        was cleared in between is not restored. */
+    void restore(const Snapshot& s);
 
     // ---------- processing/opcodes -------------
 
@@ -206,11 +540,11 @@ public:
     void o_left() { --p_tape_p_; }
     void o_right() { ++p_tape_p_; }
 
-    void o_inc() { ++tapeAt(p_tape_p_); }
-    void o_dec() { --tapeAt(p_tape_p_); }
+    void o_inc() { Brainf_traits<T>::inc(tapeAt(p_tape_p_)); }
+    void o_dec() { Brainf_traits<T>::dec(tapeAt(p_tape_p_)); }
 
-    void o_in() { T v = p_in_p_ < Index(p_in_.size()) ? p_in_[p_in_p_++] : 0; tapeAt(p_tape_p_) = v; }
-    void o_out() { p_out_.push_back(tapeAt(p_tape_p_)); }
+    void o_in() { T v = p_in_p_ < Index(p_in_.size()) ? p_in_[p_in_p_++] : T(0); tapeAt(p_tape_p_) = v; }
+    void o_out() { p_out_.push_back(readTape_(p_tape_p_)); }
 
     void o_begin();
     void o_end();
@@ -224,16 +558,127 @@ public:
     /** Convertes the characters in @p str to a vector of internal values. */
     static std::vector<T> fromString(const std::string& str);
 
+    /** Converts the ascii representation (<>+-.,[]) to opcodes,
+        anything else is skipped. */
+    static std::vector<BrainfOpcode> parseCode(const std::string& str);
+
     /** Convertes the values in @p v to a string with comma separated integers
         for each entry. */
     static std::string toStringNum(const std::vector<T>& v);
 
 private:
 
+    template <bool P>
+    BrainfRunResult runEngine_(size_t max_steps, BrainfProfile * prof);
+
+    template <BrainfEngine E, bool P>
+    BrainfRunResult run_(size_t max_steps, BrainfProfile * prof);
+
+    BrainfRunResult result_(BrainfRunStatus status, size_t steps) const
+        { return { status, steps, p_tape_lo_, p_tape_hi_ }; }
+
+    void updateJumps_();
+    /** An affine loop for BFE_OPTIMIZED */
+    struct AffineLoop_
+    {
+        BrainfAnalysis::Loop loop;
+        /** Without inner loops, the change of the cells in one
+            iteration as tape offset and value for toBits(),
+            starting with the loop cell */
+        std::vector<std::pair<Index, uint64_t>> adds;
+    };
+
+    void updateLoops_(const BrainfAnalysis& a);
+    /** Returns true when the body of the stall loop at @p pc stays in
+        the tape range from the current position, or where the tape expands.
+        Past a wrapping edge it could change the loop cell. */
+    bool stalls_(Index pc) const;
+    /** Runs affine loop @p l from its ']', see impl */
+    size_t runAffine_(const AffineLoop_& l, size_t budget);
+    /** Finds the smallest @p n > 0 with c + n * d == 0 in the cell
+        arithmetic, returns false if there is none */
+    static bool zeroAfter_(uint64_t c, uint64_t d, uint64_t& n);
+
+    static const int TAPE_PAGE_BITS = 10;
+    static const Index NO_PAGE = std::numeric_limits<Index>::min();
+    static Index pageOf_(Index pos) { return pos >> TAPE_PAGE_BITS; }
+
+    /** The cell at tape position @p pos, expands or wraps the tape.
+        With @p W, the page is marked as written. */
+    template <bool W>
+    T& cell_(Index pos)
+    {
+        if (pos >= p_win0_ && pos < p_win1_)
+        {
+            if (W)
+                p_dirty_[pageOf_(pos) - p_table0_] = 1;
+            return p_dense_[pos - p_dense0_];
+        }
+        return cellSlow_(pos, W);
+    }
+    /** The slow path of cell_() for a position outside of the window */
+    T& cellSlow_(Index pos, bool write);
+    /** Like tapeAt() for reading, does not mark the page */
+    const T& readTape_(Index pos) { return cell_<false>(pos); }
+
+    /** Makes room for the tape range, and switches to pages
+        when the dense tape would grow too large */
+    void reserve_();
+    void reserveTable_();
+    void reserveDense_();
+    void makeSparse_();
+    /** Moves page @p page of the sparse tape into p_dense_ */
+    void activate_(Index page);
+    /** Sets the window of the fast path */
+    void updateWindow_();
+    /** Page @p page of the sparse tape, wherever it is */
+    std::vector<T>& sparsePage_(Index page)
+        { return page == p_active_ ? p_dense_ : p_sparse_pages_[page - p_table0_]; }
+    const std::vector<T>& sparsePage_(Index page) const
+        { return page == p_active_ ? p_dense_ : p_sparse_pages_[page - p_table0_]; }
+    /** Sets up an empty tape for the current tape range */
+    void resetTape_();
+    /** A copy of page @p page, null for an unallocated sparse page */
+    std::shared_ptr<const std::vector<T>> copyPage_(Index page) const;
+    /** Sets page @p page to @p src, or to zero when @p src is null */
+    void writePage_(Index page, const std::vector<T> * src);
+
     std::vector<BrainfOpcode> p_code_;
-    std::vector<T> p_tape_, p_in_, p_out_;
-    Index p_code_p_, p_in_p_, p_tape_p_, p_tape_0_;
+    std::vector<bool> p_stall_;
+    std::vector<Index> p_jump_;
+    /** For the ']' of an affine loop the index into p_loops_, else -1 */
+    std::vector<Index> p_loopAt_;
+    std::vector<AffineLoop_> p_loops_;
+    std::vector<T> p_in_, p_out_;
+    /** Scratch cells of runAffine_() */
+    std::vector<T> p_window_, p_window0_;
+    /** The tape in one vector, p_dense_[0] is tape position p_dense0_.
+        For a sparse tape, this is the page that was used last. */
+    std::vector<T> p_dense_;
+    /** The sparse tape, one entry per page of the page table,
+        empty for pages that were never touched and for the page
+        that is in p_dense_ */
+    std::vector<std::vector<T>> p_sparse_pages_;
+    /** The pages of the last snapshot() or restore(), each one equals
+        the tape unless it is marked in p_dirty_ */
+    std::vector<std::shared_ptr<const std::vector<T>>> p_shared_;
+    /** Written pages, sized to the page table */
+    std::vector<uint8_t> p_dirty_;
+    Index p_code_p_, p_code_hw_, p_in_p_, p_tape_p_;
+    /** Tape positions [p_tape_lo_, p_tape_hi_) */
+    Index p_tape_lo_, p_tape_hi_;
+    /** The window of the fast path, positions that are in the tape
+        and in p_dense_ */
+    Index p_win0_, p_win1_, p_dense0_;
+    /** Page number of the sparse page in p_dense_, or NO_PAGE */
+    Index p_active_;
+    /** Page number of the first entry of the page table
+        (p_dirty_, p_shared_ and p_sparse_pages_) */
+    Index p_table0_;
+    bool p_sparse_;
     int p_flags_;
+    BrainfEngine p_engine_;
+    size_t p_maxDense_;
 };
 
 
@@ -243,6 +688,21 @@ typedef Brainf<u_int8_t> Brainf_uint8;
 typedef Brainf<int8_t> Brainf_int8;
 typedef Brainf<u_int16_t> Brainf_uint16;
 typedef Brainf<int16_t> Brainf_int16;
+typedef Brainf<u_int32_t> Brainf_uint32;
+typedef Brainf<int32_t> Brainf_int32;
+typedef Brainf<u_int64_t> Brainf_uint64;
+typedef Brainf<int64_t> Brainf_int64;
+
+typedef Brainf<Brainf_saturated<u_int8_t>> Brainf_uint8_sat;
+typedef Brainf<Brainf_saturated<int8_t>> Brainf_int8_sat;
+typedef Brainf<Brainf_saturated<u_int16_t>> Brainf_uint16_sat;
+typedef Brainf<Brainf_saturated<int16_t>> Brainf_int16_sat;
+typedef Brainf<Brainf_saturated<u_int32_t>> Brainf_uint32_sat;
+typedef Brainf<Brainf_saturated<int32_t>> Brainf_int32_sat;
+typedef Brainf<Brainf_saturated<u_int64_t>> Brainf_uint64_sat;
+typedef Brainf<Brainf_saturated<int64_t>> Brainf_int64_sat;
+
+typedef Brainf<Brainf_bignum> Brainf_big;
 
 
 
@@ -253,26 +713,80 @@ typedef Brainf<int16_t> Brainf_int16;
 // ############################## impl #################################
 
 
+inline std::string Brainf_traits<Brainf_bignum>::toString(Brainf_bignum v)
+{
+    // magnitude as four 32 bit limbs, most significant first
+    const bool neg = v.hi < 0;
+    uint64_t lo = v.lo, hi = uint64_t(v.hi);
+    if (neg)
+    {
+        lo = ~lo + 1;
+        hi = ~hi + (lo == 0);
+    }
+    uint32_t limb[4] = { uint32_t(hi >> 32), uint32_t(hi),
+                         uint32_t(lo >> 32), uint32_t(lo) };
+
+    std::string s;
+    do
+    {
+        // divide by 10, collect remainder
+        uint64_t rem = 0;
+        for (auto & l : limb)
+        {
+            uint64_t cur = (rem << 32) | l;
+            l = uint32_t(cur / 10);
+            rem = cur % 10;
+        }
+        s.insert(s.begin(), char('0' + rem));
+    }
+    while (limb[0] | limb[1] | limb[2] | limb[3]);
+
+    if (neg)
+        s.insert(s.begin(), '-');
+    return s;
+}
+
+
+
 template <typename T>
 void Brainf<T>::clear(Index tapeLength, Index tapeLengthNeg)
 {
     p_code_.clear();
+    p_stall_.clear();
+    p_jump_.clear();
+    p_loopAt_.clear();
     p_in_.clear();
     p_out_.clear();
-    p_tape_.clear();
     p_code_p_ =
     p_tape_p_ =
     p_in_p_ = 0;
-    p_tape_0_ = tapeLengthNeg; // initial negative space
-    p_tape_.resize(tapeLengthNeg + tapeLength);
+    p_code_hw_ = -1;
+    p_tape_lo_ = -tapeLengthNeg; // initial negative space
+    p_tape_hi_ = tapeLength;
+    resetTape_();
+}
+
+template <typename T>
+void Brainf<T>::setTape(const std::vector<T>& tape)
+{
+    p_tape_p_ = p_tape_lo_ = 0;
+    p_tape_hi_ = tape.size();
+    resetTape_();
+    for (size_t i = 0; i < tape.size(); ++i)
+        if (!Brainf_traits<T>::isZero(tape[i]))
+            tapeAt(i) = tape[i];
 }
 
 template <typename T>
 void Brainf<T>::setCode(const std::string &s)
 {
-    p_code_.clear();
-    p_code_p_ = 0;
+    setCode(parseCode(s));
+}
 
+template <typename T>
+std::vector<BrainfOpcode> Brainf<T>::parseCode(const std::string &s)
+{
+    std::vector<BrainfOpcode> code;
     for (auto & c : s)
     {
         BrainfOpcode op;
@@ -289,8 +803,47 @@ void Brainf<T>::setCode(const std::string &s)
             case '[': op = BFO_BEGIN; break;
             case ']': op = BFO_END; break;
         }
-        p_code_.push_back( op );
+        code.push_back( op );
+    }
+    return code;
+}
+
+template <typename T>
+void Brainf<T>::replaceCode(Index pos, Index count, const std::vector<BrainfOpcode>& code)
+{
+    const Index delta = Index(code.size()) - count;
+
+    bool brackets = false;
+    for (Index i = pos; i < pos + count && !brackets; ++i)
+        brackets = p_code_[i] == BFO_BEGIN || p_code_[i] == BFO_END;
+    for (auto op : code)
+        brackets |= op == BFO_BEGIN || op == BFO_END;
+
+    if (!brackets && p_jump_.size() == p_code_.size())
+    {
+        // move the targets behind the range, loops around it get longer
+        for (auto & j : p_jump_)
+            if (j >= pos + count)
+                j += delta;
+        p_jump_.erase(p_jump_.begin() + pos, p_jump_.begin() + pos + count);
+        p_jump_.insert(p_jump_.begin() + pos, code.size(), -1);
     }
+    else
+        p_jump_.clear();
+    p_stall_.clear();
+    p_loopAt_.clear();
+
+    p_code_.erase(p_code_.begin() + pos, p_code_.begin() + pos + count);
+    p_code_.insert(p_code_.begin() + pos, code.begin(), code.end());
+
+    if (p_code_p_ > pos && p_code_p_ >= pos + count)
+        p_code_p_ += delta;
+    else if (p_code_p_ > pos)
+        p_code_p_ = pos;
+    if (p_code_hw_ >= pos + count)
+        p_code_hw_ += delta;
+    else if (p_code_hw_ >= pos)
+        p_code_hw_ = pos;
 }
 
 template <typename T>
@@ -347,77 +900,820 @@ std::string Brainf<T>::toStringNum(const std::vector<T>& v)
     {
         if (i > 0)
             s += ", ";
-        s += std::to_string(v[i]);
+        s += Brainf_traits<T>::toString(v[i]);
     }
     return s;
 }
 
 
 template <typename T>
-void Brainf<T>::run(size_t max_steps)
+void Brainf<T>::appendInput(const std::vector<T>& input)
 {
-    size_t steps = 0;
-    // run to end of program or max_steps
-    while (p_code_p_ < (Index)p_code_.size()
-           && (max_steps == 0 || steps++ < max_steps))
+    p_in_.erase(p_in_.begin(), p_in_.begin() + std::min(p_in_p_, Index(p_in_.size())));
+    p_in_p_ = 0;
+    p_in_.insert(p_in_.end(), input.begin(), input.end());
+}
+
+template <typename T>
+void Brainf<T>::updateJumps_()
+{
+    p_jump_.assign(p_code_.size(), -1);
+    std::vector<Index> stack;
+    for (Index i = 0; i < (Index)p_code_.size(); ++i)
     {
-        const BrainfOpcode op = p_code_[p_code_p_];
+        if (p_code_[i] == BFO_BEGIN)
+            stack.push_back(i);
+        else if (p_code_[i] == BFO_END && !stack.empty())
+        {
+            p_jump_[i] = stack.back();
+            p_jump_[stack.back()] = i;
+            stack.pop_back();
+        }
+    }
+}
 
-        // this part is easy...
-        switch (op)
+template <typename T>
+BrainfRunResult Brainf<T>::run(size_t max_steps)
+{
+    return runEngine_<false>(max_steps, 0);
+}
+
+template <typename T>
+BrainfRunResult Brainf<T>::run(size_t max_steps, BrainfProfile& profile)
+{
+    profile.prepare(p_code_.size());
+    return runEngine_<true>(max_steps, &profile);
+}
+
+template <typename T>
+void Brainf<T>::updateLoops_(const BrainfAnalysis& a)
+{
+    p_loopAt_.assign(p_code_.size(), -1);
+    p_loops_.clear();
+    // the closed form needs wrapping cells
+    if (Brainf_traits<T>::bits == 0)
+        return;
+    for (auto & l : a.loops())
+    if (l.affine)
+    {
+        p_loopAt_[l.end] = p_loops_.size();
+        p_loops_.push_back(AffineLoop_());
+        AffineLoop_& al = p_loops_.back();
+        al.loop = l;
+        if (!l.counters.empty())
+            continue;
+
+        // sum up the increments of each cell
+        std::vector<int64_t> delta(l.maxOffset - l.minOffset + 1, 0);
+        Index pos = -l.minOffset;
+        for (Index i = l.begin + 1; i < l.end; ++i)
+        switch (p_code_[i])
         {
             default: break;
+            case BFO_LEFT:  --pos; break;
+            case BFO_RIGHT: ++pos; break;
+            case BFO_INC:   ++delta[pos]; break;
+            case BFO_DEC:   --delta[pos]; break;
+        }
+        al.adds.push_back(std::make_pair(Index(0), uint64_t(delta[pos])));
+        for (size_t i = 0; i < delta.size(); ++i)
+            if (delta[i] && Index(i) != pos)
+                al.adds.push_back(std::make_pair(Index(i) + l.minOffset, uint64_t(delta[i])));
+    }
+}
 
-            case BFO_LEFT:  o_left(); break;
-            case BFO_RIGHT: o_right(); break;
-            case BFO_INC:   o_inc(); break;
-            case BFO_DEC:   o_dec(); break;
-            case BFO_IN:    o_in(); break;
-            case BFO_OUT:   o_out(); break;
-            case BFO_BEGIN: o_begin(); break;
-            case BFO_END:   o_end(); break;
+template <typename T>
+bool Brainf<T>::stalls_(Index pc) const
+{
+    // stall loops have no inner loops
+    Index pos = 0, lo = 0, hi = 0;
+    for (Index i = pc + 1; p_code_[i] != BFO_END; ++i)
+    {
+        pos += (p_code_[i] == BFO_RIGHT) - (p_code_[i] == BFO_LEFT);
+        lo = std::min(lo, pos);
+        hi = std::max(hi, pos);
+    }
+    return ((p_flags_ & BFF_EXPAND_LEFT) || p_tape_p_ + lo >= p_tape_lo_)
+        && ((p_flags_ & BFF_EXPAND_RIGHT) || p_tape_p_ + hi < p_tape_hi_);
+}
+
+template <typename T>
+void Brainf<T>::compile()
+{
+    const bool
+            stall = (p_flags_ & BFF_STOP_INFINITE) && p_stall_.size() != p_code_.size(),
+            loops = p_engine_ == BFE_OPTIMIZED && p_loopAt_.size() != p_code_.size();
+    if (stall || loops)
+    {
+        const BrainfAnalysis a(p_code_);
+        if (stall)
+            p_stall_ = a.stallLoops();
+        if (loops)
+            updateLoops_(a);
+    }
+
+    if (p_engine_ != BFE_REFERENCE && p_jump_.size() != p_code_.size())
+        updateJumps_();
+}
+
+template <typename T>
+template <bool P>
+BrainfRunResult Brainf<T>::runEngine_(size_t max_steps, BrainfProfile * prof)
+{
+    compile();
+
+    switch (p_engine_)
+    {
+        case BFE_JUMPTABLE:
+            return run_<BFE_JUMPTABLE, P>(max_steps, prof);
+
+        case BFE_OPTIMIZED:
+            return run_<BFE_OPTIMIZED, P>(max_steps, prof);
+
+        default: return run_<BFE_REFERENCE, P>(max_steps, prof);
+    }
+}
+
+/* The profiling code (P == true) compiles away completely otherwise.
+   Profiling counts every opcode, so BFE_OPTIMIZED runs all loops
+   step by step then.
+
+   The steps are not counted per opcode. Between two backward jumps the
+   program counter only moves forward, so the steps since the last count
+   are the distance it moved, less the opcodes that forward jumps skipped.
+   Each opcode moves it by at least one, so with n steps left it can move
+   up to n positions without passing the step limit. That position, or
+   the end of the code, is the only bound checked per opcode. The steps
+   are counted when it is reached and at each backward jump. */
+template <typename T>
+template <BrainfEngine E, bool P>
+BrainfRunResult Brainf<T>::run_(size_t max_steps, BrainfProfile * prof)
+{
+    const bool
+            stopInfinite = p_flags_ & BFF_STOP_INFINITE,
+            waitInput = p_flags_ & BFF_WAIT_INPUT;
+    const Index num = p_code_.size();
+    const size_t limit = max_steps ? max_steps : std::numeric_limits<size_t>::max();
+
+    size_t steps = 0, tapeSize = p_tape_hi_ - p_tape_lo_;
+    // program counter at the last count, skipped opcodes since,
+    // and the bound for the program counter
+    Index from = p_code_p_, skipped = 0, stop = num;
+    // counts the steps up to position 'to' and starts over at 'next'
+    auto count = [&](Index to, Index next)
+    {
+        steps += to - from - skipped;
+        from = next;
+        skipped = 0;
+        stop = num;
+        if (limit - steps < size_t(std::max(Index(0), num - next)))
+            stop = next + Index(limit - steps);
+    };
+
+    count(p_code_p_, p_code_p_);
+    // run to end of program or max_steps
+    for (;;)
+    {
+        while (p_code_p_ < stop)
+        {
+            const BrainfOpcode op = p_code_[p_code_p_];
+            const Index pc = p_code_p_;
+
+            // this part is easy...
+            switch (op)
+            {
+                default: break;
+
+                case BFO_LEFT:  o_left(); break;
+                case BFO_RIGHT: o_right(); break;
+                case BFO_INC:   if (P) prof->countTape(p_tape_p_); o_inc(); break;
+                case BFO_DEC:   if (P) prof->countTape(p_tape_p_); o_dec(); break;
+                case BFO_IN:
+                    if (waitInput && p_in_p_ >= Index(p_in_.size()))
+                    {
+                        count(p_code_p_, p_code_p_);
+                        return result_(BFR_WAIT_INPUT, steps);
+                    }
+                    if (P) prof->countTape(p_tape_p_);
+                    o_in();
+                break;
+                case BFO_OUT:   if (P) prof->countTape(p_tape_p_); o_out(); break;
+                case BFO_BEGIN:
+                    if (P) prof->countTape(p_tape_p_);
+                    if (E == BFE_REFERENCE)
+                    {
+                        if (stopInfinite && p_stall_[p_code_p_]
+                            && !Brainf_traits<T>::isZero(readTape_(p_tape_p_))
+                            && stalls_(p_code_p_))
+                        {
+                            count(p_code_p_, p_code_p_);
+                            return result_(BFR_INFINITE, steps);
+                        }
+                        if (P && Brainf_traits<T>::isZero(readTape_(p_tape_p_)))
+                            ++prof->bracketSearches;
+                        o_begin();
+                        if (P && Brainf_traits<T>::isZero(readTape_(p_tape_p_)))
+                            prof->bracketSearchSteps += (p_code_p_ != pc ? p_code_p_ : num - 1) - pc;
+                    }
+                    else
+                    if (Brainf_traits<T>::isZero(readTape_(p_tape_p_)))
+                    {
+                        if (p_jump_[p_code_p_] >= 0)
+                            p_code_p_ = p_jump_[p_code_p_];
+                    }
+                    else if (stopInfinite && p_stall_[p_code_p_] && stalls_(p_code_p_))
+                    {
+                        count(p_code_p_, p_code_p_);
+                        return result_(BFR_INFINITE, steps);
+                    }
+                    // the loop is skipped in one step
+                    skipped += p_code_p_ - pc;
+
+                    if (P && !Brainf_traits<T>::isZero(readTape_(p_tape_p_)))
+                    {
+                        ++prof->loopEntries[pc];
+                        ++prof->loopIterations[pc];
+                    }
+                break;
+                case BFO_END:
+                    if (P) prof->countTape(p_tape_p_);
+                    if (E == BFE_REFERENCE)
+                    {
+                        if (P && !Brainf_traits<T>::isZero(readTape_(p_tape_p_)))
+                            ++prof->bracketSearches;
+                        o_end();
+                        if (P && !Brainf_traits<T>::isZero(readTape_(p_tape_p_)))
+                            prof->bracketSearchSteps += pc - (p_code_p_ != pc ? p_code_p_ : 0);
+                    }
+                    else
+                    if (!Brainf_traits<T>::isZero(readTape_(p_tape_p_))
+                        && p_jump_[p_code_p_] >= 0)
+                    {
+                        if (E == BFE_OPTIMIZED && !P && p_loopAt_[pc] >= 0)
+                        {
+                            count(p_code_p_, p_code_p_);
+                            const size_t n = runAffine_(p_loops_[p_loopAt_[pc]],
+                                        max_steps ? limit - steps
+                                                  : std::numeric_limits<size_t>::max());
+                            // back at this ']'
+                            if (n)
+                            {
+                                if (pc > p_code_hw_)
+                                    p_code_hw_ = pc;
+                                steps += n;
+                                count(p_code_p_, p_code_p_);
+                                continue;
+                            }
+                        }
+                        p_code_p_ = p_jump_[p_code_p_];
+                    }
+
+                    if (p_code_p_ != pc)
+                    {
+                        // remember the furthest position before jumping back
+                        if (pc > p_code_hw_)
+                            p_code_hw_ = pc;
+                        if (P)
+                            ++prof->loopIterations[p_code_p_];
+                        // count up to and including this ']'
+                        count(pc + 1, p_code_p_ + 1);
+                    }
+                break;
+            }
+
+            if (P)
+            {
+                ++prof->code[pc];
+                ++prof->steps;
+                if (size_t(p_tape_hi_ - p_tape_lo_) != tapeSize)
+                {
+                    ++prof->tapeExpansions;
+                    prof->tapeExpandedCells += p_tape_hi_ - p_tape_lo_ - tapeSize;
+                    tapeSize = p_tape_hi_ - p_tape_lo_;
+                }
+            }
+
+            ++p_code_p_;
         }
 
-        ++p_code_p_;
+        count(p_code_p_, p_code_p_);
+        if (p_code_p_ >= num || steps >= limit)
+            break;
     }
+
+    return result_(p_code_p_ >= num ? BFR_FINISHED : BFR_STEP_LIMIT, steps);
+}
+
+
+template <typename T>
+const size_t Brainf<T>::TAPE_PAGE_SIZE;
+
+template <typename T>
+const size_t Brainf<T>::DEFAULT_MAX_DENSE_TAPE;
+
+template <typename T>
+const int Brainf<T>::TAPE_PAGE_BITS;
+
+template <typename T>
+const typename Brainf<T>::Index Brainf<T>::NO_PAGE;
+
+
+template <typename T>
+std::vector<T> Brainf<T>::tape() const
+{
+    std::vector<T> t(p_tape_hi_ - p_tape_lo_);
+    if (!p_sparse_)
+        std::copy(p_dense_.begin() + (p_tape_lo_ - p_dense0_),
+                  p_dense_.begin() + (p_tape_hi_ - p_dense0_), t.begin());
+    else
+        for (Index pos = p_tape_lo_; pos < p_tape_hi_; ++pos)
+            t[pos - p_tape_lo_] = cell(pos);
+    return t;
+}
+
+template <typename T>
+T Brainf<T>::cell(Index pos) const
+{
+    if (pos < p_tape_lo_ || pos >= p_tape_hi_)
+        return T(0);
+    if (!p_sparse_)
+        return p_dense_[pos - p_dense0_];
+    const std::vector<T>& page = sparsePage_(pageOf_(pos));
+    return page.empty() ? T(0) : page[pos & Index(TAPE_PAGE_SIZE - 1)];
+}
+
+template <typename T>
+size_t Brainf<T>::tapeMemory() const
+{
+    size_t num = p_dense_.size();
+    for (auto & page : p_sparse_pages_)
+        num += page.size();
+    return num;
 }
 
 
 /** @todo expansion not completely tested */
 template <typename T>
-T& Brainf<T>::tapeAt(Index i)
+T& Brainf<T>::cellSlow_(Index pos, bool write)
 {
-    i += p_tape_0_;
     // expand right?
-    if (i >= (Index)p_tape_.size())
+    if (pos >= p_tape_hi_)
     {
         if (p_flags_ & BFF_EXPAND_RIGHT)
-            p_tape_.resize(i + 16);
+        {
+            p_tape_hi_ = pos + 16;
+            reserve_();
+        }
         else
-            i = i % p_tape_.size();
+            pos = p_tape_lo_ + (pos - p_tape_lo_) % (p_tape_hi_ - p_tape_lo_);
     }
     // expand left?
-    else if (i < 0)
+    else if (pos < p_tape_lo_)
     {
         if (p_flags_ & BFF_EXPAND_LEFT)
         {
-            Index si = p_tape_.size(), grow = -i + 16;
-            p_tape_.resize(si + grow);
-            // move right
-            for (Index j=si-1; j>=grow; --j)
-                p_tape_[j+grow] = p_tape_[j];
-            // clear new left
-            for (Index j=0; j<grow; ++j)
-                p_tape_[j] = T(0);
-            // adjust pointers
-            p_tape_0_ += grow;
-            i += grow;
+            p_tape_lo_ = pos - 16;
+            reserve_();
         }
         else
-            i = p_tape_.size() - 1 - ((-i) % p_tape_.size());
+            pos = p_tape_hi_ - 1 - (p_tape_lo_ - pos) % (p_tape_hi_ - p_tape_lo_);
+    }
+
+    const size_t k = pageOf_(pos) - p_table0_;
+    if (write)
+        p_dirty_[k] = 1;
+    if (p_sparse_)
+        activate_(pageOf_(pos));
+    return p_dense_[pos - p_dense0_];
+}
+
+template <typename T>
+T& Brainf<T>::tapeAt(Index i)
+{
+    return cell_<true>(i);
+}
+
+template <typename T>
+void Brainf<T>::reserve_()
+{
+    reserveTable_();
+    if (!p_sparse_)
+        reserveDense_();
+    updateWindow_();
+}
+
+template <typename T>
+void Brainf<T>::updateWindow_()
+{
+    if (p_sparse_ && p_active_ == NO_PAGE)
+        p_win0_ = p_win1_ = 0;
+    else
+    {
+        p_win0_ = std::max(p_tape_lo_, p_dense0_);
+        p_win1_ = std::min(p_tape_hi_, p_dense0_ + Index(p_dense_.size()));
+    }
+}
+
+template <typename T>
+void Brainf<T>::activate_(Index page)
+{
+    if (p_active_ != NO_PAGE)
+        p_dense_.swap(p_sparse_pages_[p_active_ - p_table0_]);
+    p_active_ = page;
+    p_dense_.swap(p_sparse_pages_[page - p_table0_]);
+    if (p_dense_.empty())
+        p_dense_.resize(TAPE_PAGE_SIZE);
+    p_dense0_ = page * Index(TAPE_PAGE_SIZE);
+    updateWindow_();
+}
+
+template <typename T>
+void Brainf<T>::reserveTable_()
+{
+    const Index
+            begin = pageOf_(p_tape_lo_),
+            end = pageOf_(p_tape_hi_ - 1) + 1,
+            t0 = p_table0_,
+            t1 = p_table0_ + Index(p_dirty_.size());
+    if (begin >= t0 && end <= t1)
+        return;
+
+    // grow by at least the current size, on the side that needs it
+    const Index
+            grow = std::max(t1 - t0, Index(1)),
+            n0 = begin < t0 ? std::min(begin, t0 - grow) : t0,
+            n1 = end > t1 ? std::max(end, t1 + grow) : t1;
+    const size_t front = t0 - n0, size = n1 - n0;
+
+    p_dirty_.insert(p_dirty_.begin(), front, 0);
+    p_dirty_.resize(size, 0);
+    if (!p_shared_.empty())
+    {
+        p_shared_.insert(p_shared_.begin(), front, nullptr);
+        p_shared_.resize(size);
+    }
+    if (p_sparse_)
+    {
+        p_sparse_pages_.insert(p_sparse_pages_.begin(), front, std::vector<T>());
+        p_sparse_pages_.resize(size);
+    }
+    p_table0_ = n0;
+}
+
+template <typename T>
+void Brainf<T>::reserveDense_()
+{
+    const Index
+            d0 = p_dense0_,
+            d1 = p_dense0_ + Index(p_dense_.size());
+    if (p_tape_lo_ >= d0 && p_tape_hi_ <= d1)
+        return;
+
+    // grow by at least the current size, on the side that needs it
+    const Index
+            grow = std::max(d1 - d0, Index(16)),
+            n0 = p_tape_lo_ < d0 ? std::min(p_tape_lo_, d0 - grow) : d0,
+            n1 = p_tape_hi_ > d1 ? std::max(p_tape_hi_, d1 + grow) : d1;
+    if (size_t(n1 - n0) > p_maxDense_)
+    {
+        makeSparse_();
+        return;
+    }
+
+    std::vector<T> d(n1 - n0);
+    std::copy(p_dense_.begin(), p_dense_.end(), d.begin() + (d0 - n0));
+    p_dense_.swap(d);
+    p_dense0_ = n0;
+}
+
+template <typename T>
+void Brainf<T>::makeSparse_()
+{
+    p_sparse_ = true;
+    p_sparse_pages_.assign(p_dirty_.size(), std::vector<T>());
+
+    // keep the pages that contain anything
+    const Index
+            d0 = p_dense0_,
+            d1 = p_dense0_ + Index(p_dense_.size());
+    for (size_t k = 0; k < p_sparse_pages_.size(); ++k)
+    {
+        const Index
+                pb = (p_table0_ + Index(k)) * Index(TAPE_PAGE_SIZE),
+                b = std::max(pb, d0),
+                e = std::min(pb + Index(TAPE_PAGE_SIZE), d1);
+        if (b >= e)
+            continue;
+        auto src = p_dense_.begin() + (b - d0), srcEnd = p_dense_.begin() + (e - d0);
+        if (std::all_of(src, srcEnd, Brainf_traits<T>::isZero))
+            continue;
+        std::vector<T>& page = p_sparse_pages_[k];
+        page.resize(TAPE_PAGE_SIZE);
+        std::copy(src, srcEnd, page.begin() + (b - pb));
+    }
+
+    std::vector<T>().swap(p_dense_);
+    p_dense0_ = 0;
+    p_active_ = NO_PAGE;
+}
+
+template <typename T>
+void Brainf<T>::resetTape_()
+{
+    p_sparse_ = false;
+    p_active_ = NO_PAGE;
+    p_sparse_pages_.clear();
+    p_shared_.clear();
+    p_dirty_.clear();
+    p_table0_ = pageOf_(p_tape_lo_);
+    // keeps the capacity when the interpreter is reused
+    p_dense_.clear();
+    p_dense0_ = p_tape_lo_;
+    if (size_t(p_tape_hi_ - p_tape_lo_) <= p_maxDense_)
+        p_dense_.resize(p_tape_hi_ - p_tape_lo_);
+    reserve_();
+}
+
+template <typename T>
+std::shared_ptr<const std::vector<T>> Brainf<T>::copyPage_(Index page) const
+{
+    if (p_sparse_)
+    {
+        const std::vector<T>& p = sparsePage_(page);
+        if (p.empty())
+            return nullptr;
+        return std::make_shared<const std::vector<T>>(p);
+    }
+
+    auto p = std::make_shared<std::vector<T>>(TAPE_PAGE_SIZE);
+    const Index
+            pb = page * Index(TAPE_PAGE_SIZE),
+            d0 = p_dense0_,
+            b = std::max(pb, d0),
+            e = std::min(pb + Index(TAPE_PAGE_SIZE), d0 + Index(p_dense_.size()));
+    if (b < e)
+        std::copy(p_dense_.begin() + (b - d0), p_dense_.begin() + (e - d0),
+                  p->begin() + (b - pb));
+    return p;
+}
+
+template <typename T>
+void Brainf<T>::writePage_(Index page, const std::vector<T> * src)
+{
+    if (p_sparse_)
+    {
+        std::vector<T>& p = sparsePage_(page);
+        if (src)
+            p = *src;
+        // the page in p_dense_ stays allocated
+        else if (page == p_active_)
+            std::fill(p.begin(), p.end(), T(0));
+        else
+            std::vector<T>().swap(p);
+        return;
+    }
+
+    const Index
+            pb = page * Index(TAPE_PAGE_SIZE),
+            d0 = p_dense0_,
+            b = std::max(pb, d0),
+            e = std::min(pb + Index(TAPE_PAGE_SIZE), d0 + Index(p_dense_.size()));
+    if (b >= e)
+        return;
+    if (src)
+        std::copy(src->begin() + (b - pb), src->begin() + (e - pb),
+                  p_dense_.begin() + (b - d0));
+    else
+        std::fill(p_dense_.begin() + (b - d0), p_dense_.begin() + (e - d0), T(0));
+}
+
+
+template <typename T>
+typename Brainf<T>::Snapshot Brainf<T>::snapshot()
+{
+    const Index
+            begin = pageOf_(p_tape_lo_),
+            end = pageOf_(p_tape_hi_ - 1) + 1;
+
+    Snapshot s;
+    s.codePos = p_code_p_;
+    s.codeHighWater = p_code_hw_;
+    s.inputPos = p_in_p_;
+    s.tapePos = p_tape_p_;
+    s.tapeBegin = p_tape_lo_;
+    s.tapeEnd = p_tape_hi_;
+    s.outputSize = p_out_.size();
+    s.pageBegin = begin;
+    s.pages.resize(end - begin);
+
+    p_shared_.resize(p_dirty_.size());
+    for (Index page = begin; page < end; ++page)
+    {
+        const size_t k = page - p_table0_;
+        if (p_dirty_[k] || !p_shared_[k])
+        {
+            p_shared_[k] = copyPage_(page);
+            p_dirty_[k] = 0;
+        }
+        s.pages[page - begin] = p_shared_[k];
+    }
+    return s;
+}
+
+template <typename T>
+void Brainf<T>::restore(const Snapshot& s)
+{
+    const Index
+            oldBegin = pageOf_(p_tape_lo_),
+            oldEnd = pageOf_(p_tape_hi_ - 1) + 1,
+            begin = s.pageBegin,
+            end = s.pageBegin + Index(s.pages.size());
+
+    p_tape_lo_ = s.tapeBegin;
+    p_tape_hi_ = s.tapeEnd;
+    reserve_();
+    p_shared_.resize(p_dirty_.size());
+
+    // cells outside of the tape are always zero
+    for (Index page = oldBegin; page < oldEnd; ++page)
+    if (page < begin || page >= end)
+    {
+        const size_t k = page - p_table0_;
+        writePage_(page, 0);
+        p_shared_[k].reset();
+        p_dirty_[k] = 0;
+    }
+
+    for (Index page = begin; page < end; ++page)
+    {
+        const size_t k = page - p_table0_;
+        const auto& sp = s.pages[page - begin];
+        if (!sp || sp != p_shared_[k] || p_dirty_[k])
+            writePage_(page, sp.get());
+        p_shared_[k] = sp;
+        p_dirty_[k] = 0;
+    }
+
+    p_code_p_ = s.codePos;
+    p_code_hw_ = s.codeHighWater;
+    p_in_p_ = s.inputPos;
+    p_tape_p_ = s.tapePos;
+    truncateOutput(s.outputSize);
+}
+
+
+/* Called at the ']' of affine loop @p l when it jumps back.
+   Without inner loops, every iteration adds the same, which is known
+   from the code. Otherwise one iteration is run on a copy of the cells that the loop can reach.
+   Only the cells of the inner loops decide what an iteration does, all
+   other cells are merely added to. So if the iteration leaves those as
+   they were, every following iteration adds the same amounts, and the
+   number of iterations until the loop cell is zero follows from modular
+   arithmetic. As many iterations as fit into @p budget steps are applied
+   at once, or only the first if they differ.
+   @p budget is the maximum of size_t for no limit.
+   Returns the number of steps, or 0 if an iteration does not fit, the
+   loop reaches outside of the tape or enters an infinite loop. */
+template <typename T>
+size_t Brainf<T>::runAffine_(const AffineLoop_& al, size_t budget)
+{
+    typedef Brainf_traits<T> Tr;
+    const BrainfAnalysis::Loop& l = al.loop;
+
+    // no expansion or wrap-around
+    const Index
+            b = p_tape_p_ + l.minOffset,
+            e = p_tape_p_ + l.maxOffset + 1;
+    if (b < p_tape_lo_ || e > p_tape_hi_)
+        return 0;
+
+    if (l.counters.empty())
+    {
+        // the jump back and the body
+        const size_t steps = l.end - l.begin;
+        uint64_t n;
+        if (!zeroAfter_(Tr::toBits(readTape_(p_tape_p_)), al.adds[0].second, n))
+        {
+            // never ends, the step limit runs out first
+            if (budget == std::numeric_limits<size_t>::max())
+                return 0;
+            n = budget;
+        }
+        n = std::min(n, uint64_t(budget / steps));
+        if (n == 0)
+            return 0;
+        for (auto & a : al.adds)
+        {
+            T& v = tapeAt(p_tape_p_ + a.first);
+            v = Tr::fromBits(Tr::toBits(v) + n * a.second);
+        }
+        return steps * n;
+    }
+
+    p_window0_.resize(e - b);
+    for (Index i = b; i < e; ++i)
+        p_window0_[i - b] = readTape_(i);
+    p_window_ = p_window0_;
+    // w[0] is the loop cell
+    T * w = p_window_.data() - l.minOffset;
+    const T * w0 = p_window0_.data() - l.minOffset;
+
+    // one iteration, starting with the jump back
+    const bool stopInfinite = p_flags_ & BFF_STOP_INFINITE;
+    size_t steps = 1;
+    Index tp = 0;
+    for (Index pc = l.begin + 1; pc != l.end; ++pc, ++steps)
+    {
+        if (steps >= budget)
+            return 0;
+        switch (p_code_[pc])
+        {
+            default: break;
+            case BFO_LEFT:  --tp; break;
+            case BFO_RIGHT: ++tp; break;
+            case BFO_INC:   Tr::inc(w[tp]); break;
+            case BFO_DEC:   Tr::dec(w[tp]); break;
+            case BFO_BEGIN:
+                if (Tr::isZero(w[tp]))
+                    pc = p_jump_[pc];
+                else if (stopInfinite && p_stall_[pc])
+                    return 0;
+            break;
+            case BFO_END:
+                if (!Tr::isZero(w[tp]))
+                    pc = p_jump_[pc];
+            break;
+        }
+    }
+
+    // the following iterations, if they do the same
+    uint64_t more = 0;
+    bool same = !Tr::isZero(w[0]);
+    for (auto o : l.counters)
+        same &= (w[o] == w0[o]);
+    if (same)
+    {
+        more = (budget - steps) / steps;
+        uint64_t n;
+        if (zeroAfter_(Tr::toBits(w[0]), Tr::toBits(w[0]) - Tr::toBits(w0[0]), n))
+            more = std::min(more, n);
+        // never ends, the step limit runs out first
+        else if (budget == std::numeric_limits<size_t>::max())
+            more = 0;
+    }
+
+    for (size_t i = 0; i < p_window_.size(); ++i)
+    {
+        if (more)
+        {
+            const uint64_t d = Tr::toBits(p_window_[i]) - Tr::toBits(p_window0_[i]);
+            if (d)
+                p_window_[i] = Tr::fromBits(Tr::toBits(p_window_[i]) + more * d);
+        }
+        if (p_window_[i] != p_window0_[i])
+            tapeAt(b + i) = p_window_[i];
+    }
+
+    return steps * (1 + more);
+}
+
+template <typename T>
+bool Brainf<T>::zeroAfter_(uint64_t c, uint64_t d, uint64_t& n)
+{
+    const int bits = Brainf_traits<T>::bits;
+    const uint64_t mask = bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+    c &= mask;
+    d &= mask;
+    if (!d)
+        return false;
+    // the usual [-] and [+]
+    if (d == mask)
+    {
+        n = c;
+        return true;
+    }
+    if (d == 1)
+    {
+        n = (0 - c) & mask;
+        return true;
     }
 
-    return p_tape_[i];
+    // d = o * 2^t with odd o, c must be a multiple of 2^t
+    int t = 0;
+    while (!((d >> t) & 1))
+        ++t;
+    if (c & ((uint64_t(1) << t) - 1))
+        return false;
+
+    // inverse of o modulo 2^64, each Newton step doubles the valid bits
+    const uint64_t o = d >> t;
+    uint64_t inv = o;
+    for (int i = 0; i < 5; ++i)
+        inv *= 2 - o * inv;
+
+    // n * o == -c / 2^t modulo 2^(bits - t)
+    n = ((((0 - c) & mask) >> t) * inv) & (mask >> t);
+    return true;
 }
 
 
@@ -425,14 +1721,13 @@ template <typename T>
 void Brainf<T>::o_begin()
 {
     // break if zero
-    if (!tapeAt(p_tape_p_))
+    if (Brainf_traits<T>::isZero(readTape_(p_tape_p_)))
     {
         // move to end bracket
         Index i = p_code_p_,
               lvl = 1;
-        while (i < (Index)p_code_.size())
+        while (++i < (Index)p_code_.size())
         {
-            ++i;
             if (p_code_[i] == BFO_BEGIN)
                 ++lvl;
             else
@@ -450,14 +1745,13 @@ template <typename T>
 void Brainf<T>::o_end()
 {
     // jump back if not zero
-    if (tapeAt(p_tape_p_))
+    if (!Brainf_traits<T>::isZero(readTape_(p_tape_p_)))
     {
         // move to start bracket
         Index i = p_code_p_,
               lvl = 1;
-        while (i >= 0)
+        while (--i >= 0)
         {
-            --i;
             if (p_code_[i] == BFO_END)
                 ++lvl;
             else
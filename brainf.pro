@@ -16,13 +16,24 @@ SOURCES += main.cpp\
         mainwindow.cpp \
     gene.cpp \
     genepool.cpp \
-    brainfgene.cpp
+    brainfgene.cpp \
+    brainfcode.cpp \
+    brainfthread.cpp \
+    genethread.cpp
 
 HEADERS  += mainwindow.h \
     brainf.h \
+    brainfanalysis.h \
+    brainfprofile.h \
     gene.h \
     genepool.h \
-    brainfgene.h
+    brainfgene.h \
+    brainfcode.h \
+    brainfthread.h \
+    brainfdebugger.h \
+    brainfscheduler.h \
+    triplebuffer.h \
+    genethread.h
 
 OTHER_FILES += \
     appstyle.css
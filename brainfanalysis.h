@@ -0,0 +1,401 @@
+/** @file brainfanalysis.h
+
+    @brief Static analysis of brainfuck opcodes
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+// needs to come first, brainf.h includes this file after BrainfOpcode
+#include "brainf.h"
+
+#ifndef BRAINFANALYSIS_H
+#define BRAINFANALYSIS_H
+
+/** Static analysis pass over a vector of BrainfOpcode.
+
+    Finds loops that provably never terminate, code that can not
+    contribute to the output and programs that never output anything,
+    without executing them.
+
+    The analysis makes no assumption about the cell type, e.g.
+    '[+]' terminates for wrapping 8 bit cells but not for saturating ones,
+    so it is not reported. Only loops whose body leaves the tape position
+    and the loop cell unchanged are considered non-terminating.
+    Different tape positions are assumed to be different cells,
+    which is true for expanding tapes. Where the tape wraps around, the
+    loop can reach its own cell and Brainf checks the range of the body
+    before it stops at the loop.
+
+    Loops that return to the same tape position after every iteration,
+    including all inner loops, and that do no input or output are marked
+    as affine. Each iteration adds to the cells, depending only on the
+    cells that control the inner loops, which lets Brainf with
+    BFE_OPTIMIZED run them in closed form.
+*/
+class BrainfAnalysis
+{
+public:
+
+    typedef std::ptrdiff_t Index;
+
+    /** Information about one loop */
+    struct Loop
+    {
+        /** Positions of '[' and ']' */
+        Index begin, end;
+        /** Nesting depth, 0 for outermost loops */
+        int depth;
+        /** No inner loops and no input */
+        bool simple;
+        /** Net tape movement of one iteration (valid if simple) */
+        Index move;
+        /** Net change of the loop cell in one iteration (valid if simple) */
+        int64_t delta;
+        /** Body, including inner loops, contains output */
+        bool hasOutput;
+        /** The loop never terminates once entered */
+        bool infinite;
+        /** Every iteration and every inner loop has a net tape movement
+            of zero, and there is no input or output */
+        bool affine;
+        /** Range of tape offsets, relative to the loop cell,
+            that an iteration can touch (valid if affine) */
+        Index minOffset, maxOffset;
+        /** Tape offsets of the cells of the inner loops (valid if affine) */
+        std::vector<Index> counters;
+    };
+
+    /** Analyzes @p code and runs up to @p maxSteps of the start of the
+        program on an empty tape like the one of
+        Brainf(tapeLength, tapeLengthNeg, flags).
+        The run stops being exact and ends where the program moves past
+        an edge of the tape that wraps around instead of expanding.
+        Without @p maxSteps, the start of the program is not run,
+        canOutput() equals hasOutput() and stallPosition() is -1. */
+    explicit BrainfAnalysis(const std::vector<BrainfOpcode>& code, size_t maxSteps = 0,
+                            Index tapeLength = 16, Index tapeLengthNeg = 16,
+                            int flags = BFF_EXPAND_RIGHT)
+        { analyze_(code, maxSteps, tapeLength, tapeLengthNeg, flags); }
+
+    // ---------------- getter -------------------
+
+    /** Returns true when all brackets have a partner */
+    bool isBalanced() const { return p_balanced_; }
+
+    /** Returns true when the code contains an output opcode at all */
+    bool hasOutput() const { return p_lastOut_ >= 0; }
+
+    /** Returns true when an output opcode might be reached.
+        This is false for code without output and for code that provably
+        gets stuck in an infinite loop before the first output. */
+    bool canOutput() const { return p_canOutput_; }
+
+    /** Returns the position of the last output opcode, or -1 */
+    Index lastOutput() const { return p_lastOut_; }
+
+    /** Returns the length of the code that can contribute to the output.
+        Everything from this position on is dead code with respect to output.
+        This is the position after the last '.', or after the end of the
+        outermost loop enclosing it. */
+    Index outputEnd() const { return p_outEnd_; }
+
+    /** Returns the position where the program provably stalls forever
+        without output when started on an empty tape, or -1 if unknown. */
+    Index stallPosition() const { return p_stall_; }
+
+    /** Returns all loops in order of their '[' */
+    const std::vector<Loop>& loops() const { return p_loops_; }
+
+    /** Returns the position of the matching bracket for a bracket at
+        position @p i, or -1 if unmatched or no bracket. */
+    Index match(Index i) const { return p_match_[i]; }
+
+    /** Returns true when the loop starting or ending at @p i is
+        provably infinite and does not produce output. */
+    bool isStallLoop(Index i) const;
+
+    /** Returns a flag for each code position that is true for
+        '[' opcodes starting a loop that isStallLoop(). */
+    std::vector<bool> stallLoops() const;
+
+private:
+
+    void analyze_(const std::vector<BrainfOpcode>& code, size_t maxSteps,
+                  Index tapeLength, Index tapeLengthNeg, int flags);
+    static void inspectAffine_(const std::vector<BrainfOpcode>& code, Loop& l);
+    void simulate_(const std::vector<BrainfOpcode>& code, size_t maxSteps,
+                   Index tapeLength, Index tapeLengthNeg, int flags);
+
+    std::vector<Index> p_match_, p_loopIndex_;
+    std::vector<Loop> p_loops_;
+    Index p_lastOut_, p_outEnd_, p_stall_;
+    bool p_balanced_, p_canOutput_;
+};
+
+
+
+// ############################## impl #################################
+
+
+inline bool BrainfAnalysis::isStallLoop(Index i) const
+{
+    if (i < 0 || i >= Index(p_loopIndex_.size()) || p_loopIndex_[i] < 0)
+        return false;
+    const Loop& l = p_loops_[p_loopIndex_[i]];
+    return l.infinite && !l.hasOutput;
+}
+
+inline std::vector<bool> BrainfAnalysis::stallLoops() const
+{
+    std::vector<bool> v(p_match_.size(), false);
+    for (auto & l : p_loops_)
+        if (l.infinite && !l.hasOutput)
+            v[l.begin] = true;
+    return v;
+}
+
+inline void BrainfAnalysis::analyze_(const std::vector<BrainfOpcode>& code, size_t maxSteps,
+                                     Index tapeLength, Index tapeLengthNeg, int flags)
+{
+    const Index num = code.size();
+
+    p_match_.assign(num, -1);
+    p_loopIndex_.assign(num, -1);
+    p_loops_.clear();
+    p_lastOut_ = p_stall_ = -1;
+    p_balanced_ = true;
+
+    // match brackets
+    std::vector<Index> stack;
+    for (Index i = 0; i < num; ++i)
+    {
+        if (code[i] == BFO_BEGIN)
+        {
+            p_loopIndex_[i] = p_loops_.size();
+            Loop l;
+            l.begin = i;
+            l.end = -1;
+            l.depth = stack.size();
+            l.simple = true;
+            l.move = 0;
+            l.delta = 0;
+            l.hasOutput = false;
+            l.infinite = false;
+            l.affine = false;
+            l.minOffset = l.maxOffset = 0;
+            p_loops_.push_back(l);
+            stack.push_back(i);
+        }
+        else if (code[i] == BFO_END)
+        {
+            if (stack.empty())
+            {
+                p_balanced_ = false;
+                continue;
+            }
+            const Index b = stack.back();
+            stack.pop_back();
+            p_match_[b] = i;
+            p_match_[i] = b;
+            p_loopIndex_[i] = p_loopIndex_[b];
+            p_loops_[p_loopIndex_[b]].end = i;
+        }
+        else if (code[i] == BFO_OUT)
+        {
+            p_lastOut_ = i;
+            // every open loop contains output
+            for (auto b : stack)
+                p_loops_[p_loopIndex_[b]].hasOutput = true;
+        }
+    }
+    if (!stack.empty())
+        p_balanced_ = false;
+
+    // inspect loop bodies
+    for (auto & l : p_loops_)
+    {
+        if (l.end < 0)
+        {
+            l.simple = false;
+            continue;
+        }
+        Index pos = 0;
+        for (Index i = l.begin + 1; i < l.end && l.simple; ++i)
+        {
+            switch (code[i])
+            {
+                default: break;
+                case BFO_LEFT:  --pos; break;
+                case BFO_RIGHT: ++pos; break;
+                case BFO_INC:   if (pos == 0) ++l.delta; break;
+                case BFO_DEC:   if (pos == 0) --l.delta; break;
+                case BFO_IN:
+                case BFO_BEGIN:
+                case BFO_END:   l.simple = false; break;
+            }
+        }
+        if (l.simple)
+        {
+            l.move = pos;
+            // the loop cell is the same and unchanged after each iteration
+            l.infinite = (pos == 0 && l.delta == 0);
+        }
+        else
+            l.move = l.delta = 0;
+
+        inspectAffine_(code, l);
+    }
+
+    // dead code after last output
+    p_outEnd_ = p_lastOut_ + 1;
+    if (p_lastOut_ >= 0)
+        for (auto & l : p_loops_)
+            if (l.hasOutput && l.end >= p_outEnd_)
+                p_outEnd_ = l.end + 1;
+
+    p_canOutput_ = hasOutput();
+    if (maxSteps)
+        simulate_(code, maxSteps, tapeLength, tapeLengthNeg, flags);
+}
+
+inline void BrainfAnalysis::inspectAffine_(const std::vector<BrainfOpcode>& code, Loop& l)
+{
+    l.affine = l.end >= 0;
+    l.minOffset = l.maxOffset = 0;
+    l.counters.clear();
+
+    // tape offsets at the '[' of the open inner loops
+    std::vector<Index> open;
+    Index pos = 0;
+    for (Index i = l.begin + 1; i < l.end && l.affine; ++i)
+    {
+        switch (code[i])
+        {
+            default: break;
+            case BFO_LEFT:  --pos; break;
+            case BFO_RIGHT: ++pos; break;
+            case BFO_IN:
+            case BFO_OUT:   l.affine = false; break;
+            case BFO_BEGIN:
+                open.push_back(pos);
+                l.counters.push_back(pos);
+            break;
+            // brackets inside of a matched loop are matched as well
+            case BFO_END:
+                l.affine = (open.back() == pos);
+                open.pop_back();
+            break;
+        }
+        l.minOffset = std::min(l.minOffset, pos);
+        l.maxOffset = std::max(l.maxOffset, pos);
+    }
+
+    if (l.affine && pos == 0)
+    {
+        std::sort(l.counters.begin(), l.counters.end());
+        l.counters.erase(std::unique(l.counters.begin(), l.counters.end()),
+                         l.counters.end());
+    }
+    else
+    {
+        l.affine = false;
+        l.minOffset = l.maxOffset = 0;
+        l.counters.clear();
+    }
+}
+
+/* Runs the start of the program on an abstract tape to find out if
+   the first output is reached or if the program stalls before.
+   Cell values are only treated as known within [0,127], where all
+   cell types (signed/unsigned, wrapping/saturating) agree.
+   Positions past a wrapping edge of the tape alias other cells, so the
+   run gives up when it gets there, or when a stall loop would. */
+inline void BrainfAnalysis::simulate_(const std::vector<BrainfOpcode>& code, size_t maxSteps,
+                                      Index tapeLength, Index tapeLengthNeg, int flags)
+{
+    if (!p_canOutput_ || !p_balanced_)
+        return;
+
+    // the range of positions that are distinct cells
+    const Index
+            lo = (flags & BFF_EXPAND_LEFT)
+                    ? std::numeric_limits<Index>::min() : -tapeLengthNeg,
+            hi = (flags & BFF_EXPAND_RIGHT)
+                    ? std::numeric_limits<Index>::max() : tapeLength;
+
+    const int8_t unknown = -1;
+    // cells from position -zero on, grown on demand
+    std::vector<int8_t> tape(32, 0);
+    Index tp = 0, zero = 16;
+    const Index num = code.size();
+
+    for (Index pc = 0; pc < num && maxSteps; ++pc, --maxSteps)
+    {
+        int8_t& v = tape[tp + zero];
+
+        switch (code[pc])
+        {
+            default: break;
+            case BFO_LEFT:
+                if (--tp < lo)
+                    return;
+                if (tp + zero < 0)
+                {
+                    tape.insert(tape.begin(), tape.size(), 0);
+                    zero += tape.size() / 2;
+                }
+            break;
+            case BFO_RIGHT:
+                if (++tp >= hi)
+                    return;
+                if (tp + zero >= Index(tape.size()))
+                    tape.resize(tape.size() * 2, 0);
+            break;
+            case BFO_INC:
+                if (v != unknown)
+                    v = v < 127 ? v + 1 : unknown;
+            break;
+            case BFO_DEC:
+                if (v != unknown)
+                    v = v > 0 ? v - 1 : unknown;
+            break;
+            case BFO_IN: v = unknown; break;
+            // reached output
+            case BFO_OUT: return;
+            case BFO_BEGIN:
+                if (v == unknown)
+                    return;
+                if (v == 0)
+                    pc = p_match_[pc];
+                else if (isStallLoop(pc))
+                {
+                    // the body could reach the loop cell from the other side
+                    const Loop& l = p_loops_[p_loopIndex_[pc]];
+                    if (tp + l.minOffset < lo || tp + l.maxOffset >= hi)
+                        return;
+                    p_stall_ = pc;
+                    p_canOutput_ = false;
+                    return;
+                }
+            break;
+            case BFO_END:
+                if (v == unknown)
+                    return;
+                if (v != 0)
+                    pc = p_match_[pc];
+            break;
+        }
+    }
+}
+
+
+#endif // BRAINFANALYSIS_H
@@ -0,0 +1,235 @@
+/** @file brainfbatch.h
+
+    @brief Running many brainfuck programs on a number of threads
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#ifndef BRAINFBATCH_H
+#define BRAINFBATCH_H
+
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "brainf.h"
+
+/** Runs a list of independent programs on a number of threads.
+
+    Each thread keeps one interpreter that is cleared and reused for
+    all of its jobs, so memory is allocated only while the interpreters
+    grow to the largest job. The threads take jobs in small chunks
+    from a shared counter, so long and short jobs are spread evenly.
+
+    The output of all jobs is collected in one arena, ordered by job.
+    Each thread first appends to its own arena, which is kept between
+    runs, and the results are copied into the common arena at the end,
+    which is allocated once to the final size.
+*/
+template <typename T>
+class BrainfBatch
+{
+public:
+
+    struct Job
+    {
+        std::string code, input;
+        /** Step limit, 0 for unlimited */
+        size_t maxSteps;
+    };
+
+    struct Result
+    {
+        /** BFR_UNBALANCED for code with unmatched brackets,
+            which is not run. Never BFR_WAIT_INPUT. */
+        BrainfRunStatus status;
+        size_t steps;
+        /** Range of the output in BrainfBatch::output() */
+        size_t outputBegin, outputLength;
+    };
+
+    /** Creates a batch runner for interpreters with @p flags
+        (or-combination of BrainfFlags) and @p engine */
+    explicit BrainfBatch(int flags = BFF_EXPAND_RIGHT,
+                         BrainfEngine engine = BFE_JUMPTABLE)
+        : p_flags_      (flags & ~BFF_WAIT_INPUT)
+        , p_engine_     (engine)
+        , p_numThreads_ (std::max(1u, std::thread::hardware_concurrency()))
+    { }
+
+    // ---------------- getter -------------------
+
+    int flags() const { return p_flags_; }
+    BrainfEngine engine() const { return p_engine_; }
+    size_t numThreads() const { return p_numThreads_; }
+
+    /** The results of the last run(), one per job */
+    const std::vector<Result>& results() const { return p_results_; }
+
+    /** The output of all jobs of the last run() */
+    const std::vector<T>& output() const { return p_output_; }
+
+    /** Returns the output of job @p i as std::string */
+    std::string outputString(size_t i) const
+    {
+        const Result& r = p_results_[i];
+        return Brainf<T>::toString(std::vector<T>(
+            p_output_.begin() + r.outputBegin,
+            p_output_.begin() + r.outputBegin + r.outputLength));
+    }
+
+    // ---------------- setter -------------------
+
+    /** Sets the interpreter flags, BFF_WAIT_INPUT is ignored */
+    void setFlags(int flags) { p_flags_ = flags & ~BFF_WAIT_INPUT; }
+    void setEngine(BrainfEngine e) { p_engine_ = e; }
+    /** Sets the number of threads, the default is the number of cores */
+    void setNumThreads(size_t num) { p_numThreads_ = std::max(size_t(1), num); }
+
+    // -------------- execute --------------------
+
+    /** Runs all @p jobs and returns when they are done.
+        Without BFF_STOP_INFINITE, a job without maxSteps
+        might never return.
+        Returns the number of steps of all jobs. */
+    size_t run(const std::vector<Job>& jobs);
+
+private:
+
+    /** Number of jobs a thread takes at once */
+    static const size_t JOB_CHUNK = 8;
+
+    struct Worker
+    {
+        Brainf<T> bf;
+        std::vector<T> output;
+        size_t steps;
+    };
+
+    void work_(Worker& w, const std::vector<Job>& jobs, std::atomic<size_t>& next);
+
+    int p_flags_;
+    BrainfEngine p_engine_;
+    size_t p_numThreads_;
+    std::vector<Worker> p_workers_;
+    std::vector<Result> p_results_;
+    /** For each job the worker whose arena holds the output */
+    std::vector<size_t> p_worker_;
+    std::vector<T> p_output_;
+};
+
+
+
+
+// ############################## impl #################################
+
+template <typename T>
+const size_t BrainfBatch<T>::JOB_CHUNK;
+
+template <typename T>
+size_t BrainfBatch<T>::run(const std::vector<Job>& jobs)
+{
+    p_results_.resize(jobs.size());
+    p_worker_.resize(jobs.size());
+
+    const size_t num = std::max(size_t(1), std::min(p_numThreads_,
+                        (jobs.size() + JOB_CHUNK - 1) / JOB_CHUNK));
+    p_workers_.resize(std::max(p_workers_.size(), num));
+    for (size_t i = 0; i < num; ++i)
+    {
+        p_workers_[i].output.clear();
+        p_workers_[i].steps = 0;
+    }
+
+    std::atomic<size_t> next(0);
+    if (num == 1)
+        work_(p_workers_[0], jobs, next);
+    else
+    {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < num; ++i)
+            threads.push_back(std::thread([&, i]()
+            {
+                work_(p_workers_[i], jobs, next);
+            }));
+        for (auto & t : threads)
+            t.join();
+    }
+
+    // copy the worker arenas into one, in job order
+    size_t size = 0, steps = 0;
+    for (size_t i = 0; i < num; ++i)
+    {
+        size += p_workers_[i].output.size();
+        steps += p_workers_[i].steps;
+    }
+    p_output_.resize(size);
+    size_t pos = 0;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        Result& r = p_results_[i];
+        const T * src = p_workers_[p_worker_[i]].output.data() + r.outputBegin;
+        std::copy(src, src + r.outputLength, p_output_.begin() + pos);
+        r.outputBegin = pos;
+        pos += r.outputLength;
+    }
+
+    return steps;
+}
+
+template <typename T>
+void BrainfBatch<T>::work_(Worker& w, const std::vector<Job>& jobs,
+                           std::atomic<size_t>& next)
+{
+    const size_t worker = &w - &p_workers_[0];
+    for (;;)
+    {
+        const size_t begin = next.fetch_add(JOB_CHUNK);
+        if (begin >= jobs.size())
+            break;
+
+        for (size_t i = begin; i < std::min(begin + JOB_CHUNK, jobs.size()); ++i)
+        {
+            const Job& job = jobs[i];
+            Result& r = p_results_[i];
+            p_worker_[i] = worker;
+            r.steps = 0;
+            r.outputBegin = w.output.size();
+            r.outputLength = 0;
+
+            w.bf.clear();
+            w.bf.setFlags(p_flags_);
+            w.bf.setEngine(p_engine_);
+            w.bf.setCode(job.code);
+
+            // brackets must match
+            int depth = 0;
+            for (auto op : w.bf.code())
+                if ((depth += (op == BFO_BEGIN) - (op == BFO_END)) < 0)
+                    break;
+            if (depth != 0)
+            {
+                r.status = BFR_UNBALANCED;
+                continue;
+            }
+
+            w.bf.setInput(job.input);
+            const BrainfRunResult res = w.bf.run(job.maxSteps);
+            r.status = res.status;
+            r.steps = res.steps;
+            w.steps += r.steps;
+
+            w.output.insert(w.output.end(), w.bf.output().begin(), w.bf.output().end());
+            r.outputLength = w.bf.output().size();
+        }
+    }
+}
+
+
+#endif // BRAINFBATCH_H
@@ -0,0 +1,28 @@
+#-------------------------------------------------
+#
+# Benchmarks for interpreter engines and GA, no Qt dependency
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG += console c++11 thread
+CONFIG -= app_bundle qt
+
+TARGET = brainf-bench
+TEMPLATE = app
+
+
+SOURCES += benchmain.cpp \
+    gene.cpp \
+    genepool.cpp \
+    brainfgene.cpp \
+    brainfcode.cpp
+
+HEADERS  += brainf.h \
+    brainfanalysis.h \
+    brainfprofile.h \
+    gene.h \
+    genepool.h \
+    brainfgene.h \
+    brainfcode.h \
+    brainfbatch.h
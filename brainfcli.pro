@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# Headless command line runner, no Qt dependency
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG += console c++11 thread
+CONFIG -= app_bundle qt
+
+TARGET = brainf-cli
+TEMPLATE = app
+
+
+SOURCES += climain.cpp \
+    gene.cpp \
+    genepool.cpp \
+    brainfgene.cpp \
+    brainfcode.cpp \
+    geneevaluator.cpp
+
+HEADERS  += brainf.h \
+    brainfanalysis.h \
+    brainfprofile.h \
+    gene.h \
+    genepool.h \
+    brainfgene.h \
+    brainfcode.h \
+    geneevaluator.h
@@ -0,0 +1,362 @@
+/** @file brainfcode.cpp
+
+    @brief Editable brainfuck code with a bracket index
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#include <algorithm>
+
+#include "brainfcode.h"
+
+/** Minimum size of the buffer when it grows */
+#define MIN_BUFFER 16
+/** Odd multiplier of the code hash */
+#define HASH_PRIME 0x100000001b3ull
+
+namespace {
+
+    /** HASH_PRIME^-1 modulo 2^64, each Newton step doubles the correct bits */
+    const uint64_t hashInverse = []()
+    {
+        uint64_t x = HASH_PRIME;
+        for (int i = 0; i < 5; ++i)
+            x *= 2 - HASH_PRIME * x;
+        return x;
+    }();
+
+    uint64_t hashPower(size_t n)
+    {
+        uint64_t p = 1, b = HASH_PRIME;
+        for (; n; n >>= 1, b *= b)
+            if (n & 1)
+                p *= b;
+        return p;
+    }
+
+} // namespace
+
+const size_t BrainfCode::NO_MATCH;
+const uint32_t BrainfCode::NO_INDEX;
+
+BrainfCode::BrainfCode()
+    : p_gap0_   (0)
+    , p_gap1_   (0)
+    , p_hash0_  (0)
+    , p_hash1_  (0)
+    , p_pow0_   (1)
+{
+    std::fill(p_count_, p_count_ + BFO_END + 1, 0);
+}
+
+BrainfCode::BrainfCode(const std::vector<BrainfOpcode>& code)
+{
+    assign(code);
+}
+
+void BrainfCode::assign(const std::vector<BrainfOpcode>& code)
+{
+    p_buf_ = code;
+    p_gap0_ = p_gap1_ = p_buf_.size();
+    p_hash0_ = p_hash1_ = 0;
+    p_pow0_ = 1;
+    std::fill(p_count_, p_count_ + BFO_END + 1, 0);
+    for (auto op : p_buf_)
+    {
+        p_hash0_ += uint64_t(op) * p_pow0_;
+        p_pow0_ *= HASH_PRIME;
+        ++p_count_[op];
+    }
+    p_changes_.assign(1, Change{ 0, p_buf_.size() });
+    buildIndex_();
+}
+
+void BrainfCode::clear()
+{
+    p_buf_.clear();
+    p_match_.clear();
+    p_gap0_ = p_gap1_ = 0;
+    p_hash0_ = p_hash1_ = 0;
+    p_pow0_ = 1;
+    std::fill(p_count_, p_count_ + BFO_END + 1, 0);
+    p_changes_.assign(1, Change{ 0, 0 });
+}
+
+size_t BrainfCode::match(size_t pos) const
+{
+    const uint32_t m = p_match_[phys_(pos)];
+    if (m == NO_INDEX)
+        return NO_MATCH;
+    return m < p_gap0_ ? m : m - (p_gap1_ - p_gap0_);
+}
+
+void BrainfCode::copy(std::vector<BrainfOpcode>& code, size_t pos, size_t count) const
+{
+    pos = std::min(pos, size());
+    const size_t end = pos + std::min(count, size() - pos),
+                 mid = std::max(pos, std::min(end, p_gap0_));
+    code.insert(code.end(), p_buf_.begin() + pos, p_buf_.begin() + mid);
+    code.insert(code.end(), p_buf_.begin() + phys_(mid), p_buf_.begin() + phys_(end));
+}
+
+bool BrainfCode::operator == (const BrainfCode& other) const
+{
+    if (size() != other.size() || hash() != other.hash())
+        return false;
+    for (size_t i = 0; i < size(); ++i)
+        if ((*this)[i] != other[i])
+            return false;
+    return true;
+}
+
+void BrainfCode::close()
+{
+    openGap_(size(), 0);
+    p_buf_.resize(p_gap0_);
+    p_match_.resize(p_gap0_);
+    p_gap1_ = p_gap0_;
+}
+
+void BrainfCode::set(size_t pos, BrainfOpcode op)
+{
+    BrainfOpcode & o = p_buf_[phys_(pos)];
+    const bool bracket = o == BFO_BEGIN || o == BFO_END
+                      || op == BFO_BEGIN || op == BFO_END;
+    const uint64_t d = uint64_t(op) - uint64_t(o);
+    if (pos < p_gap0_)
+        p_hash0_ += d * hashPower(pos);
+    else
+        p_hash1_ += d * hashPower(pos - p_gap0_);
+    --p_count_[o];
+    ++p_count_[op];
+    o = op;
+    change_(pos, 1, 1);
+    if (bracket)
+        buildIndex_();
+}
+
+void BrainfCode::insert(size_t pos, BrainfOpcode op)
+{
+    pos = std::min(pos, size());
+    openGap_(pos, 1);
+    p_buf_[p_gap0_] = op;
+    p_match_[p_gap0_] = NO_INDEX;
+    ++p_gap0_;
+    p_hash0_ += uint64_t(op) * p_pow0_;
+    p_pow0_ *= HASH_PRIME;
+    ++p_count_[op];
+    change_(pos, 1, 0);
+
+    if (op == BFO_BEGIN || op == BFO_END)
+        buildIndex_();
+}
+
+void BrainfCode::insertLoop(size_t pos, BrainfOpcode body)
+{
+    // a new adjacent pair does not change the other matches
+    pos = std::min(pos, size());
+    openGap_(pos, 3);
+    const size_t i = p_gap0_;
+    p_buf_[i] = BFO_BEGIN;
+    p_buf_[i + 1] = body;
+    p_buf_[i + 2] = BFO_END;
+    p_match_[i] = i + 2;
+    p_match_[i + 1] = NO_INDEX;
+    p_match_[i + 2] = i;
+    p_gap0_ += 3;
+    for (size_t j = i; j < i + 3; ++j)
+    {
+        p_hash0_ += uint64_t(p_buf_[j]) * p_pow0_;
+        p_pow0_ *= HASH_PRIME;
+        ++p_count_[p_buf_[j]];
+    }
+    change_(pos, 3, 0);
+}
+
+void BrainfCode::erase(size_t pos)
+{
+    if (pos >= size())
+        return;
+
+    // removing a pair or an unmatched bracket
+    // does not change the other matches
+    const size_t m = match(pos);
+    if (m == NO_MATCH)
+    {
+        eraseOne_(pos);
+        change_(pos, 0, 1);
+    }
+    else
+    {
+        eraseOne_(std::max(pos, m));
+        change_(std::max(pos, m), 0, 1);
+        eraseOne_(std::min(pos, m));
+        change_(std::min(pos, m), 0, 1);
+    }
+}
+
+void BrainfCode::erase(size_t pos, size_t count)
+{
+    if (pos >= size())
+        return;
+    count = std::min(count, size() - pos);
+    bool rebuild = false;
+    for (size_t i = pos; i < pos + count && !rebuild; ++i)
+    {
+        const size_t m = match(i);
+        rebuild = m != NO_MATCH && (m < pos || m >= pos + count);
+    }
+    for (size_t i = 0; i < count; ++i)
+        eraseOne_(pos);
+    change_(pos, 0, count);
+    if (rebuild)
+        buildIndex_();
+}
+
+void BrainfCode::eraseOne_(size_t pos)
+{
+    openGap_(pos, 0);
+    const uint32_t m = p_match_[p_gap1_];
+    if (m != NO_INDEX)
+        p_match_[m] = NO_INDEX;
+    p_hash1_ = (p_hash1_ - uint64_t(p_buf_[p_gap1_])) * hashInverse;
+    --p_count_[p_buf_[p_gap1_]];
+    ++p_gap1_;
+}
+
+void BrainfCode::change_(size_t pos, size_t num, size_t erased)
+{
+    // positions behind the edit move, erased ones collapse to pos
+    auto map = [=](size_t x)
+    {
+        return x < pos ? x : x < pos + erased ? pos : x - erased + num;
+    };
+    size_t i = 0;
+    while (i < p_changes_.size() && p_changes_[i].begin < pos)
+        ++i;
+    for (auto & c : p_changes_)
+    {
+        c.begin = map(c.begin);
+        c.end = map(c.end);
+    }
+    p_changes_.insert(p_changes_.begin() + i, Change{ pos, pos + num });
+
+    // merge with the touching neighbours
+    if (i > 0 && p_changes_[i - 1].end >= pos)
+    {
+        --i;
+        p_changes_[i].end = std::max(p_changes_[i].end, pos + num);
+        p_changes_.erase(p_changes_.begin() + i + 1);
+    }
+    while (i + 1 < p_changes_.size() && p_changes_[i + 1].begin <= p_changes_[i].end)
+    {
+        p_changes_[i].end = std::max(p_changes_[i].end, p_changes_[i + 1].end);
+        p_changes_.erase(p_changes_.begin() + i + 1);
+    }
+}
+
+void BrainfCode::openGap_(size_t pos, size_t size)
+{
+    if (p_gap1_ - p_gap0_ < size)
+    {
+        // grow, the tail goes to the end of the buffer
+        const size_t
+                need = this->size() + size,
+                num = std::max(std::max(need, p_buf_.capacity()),
+                               size_t(MIN_BUFFER)),
+                tail = p_buf_.size() - p_gap1_;
+        p_buf_.resize(num < 2 * need ? 2 * need : num);
+        p_match_.resize(p_buf_.size(), NO_INDEX);
+        move_(p_gap1_, p_buf_.size() - tail, tail);
+        p_gap1_ = p_buf_.size() - tail;
+    }
+
+    if (pos < p_gap0_)
+    {
+        const size_t d = p_gap0_ - pos;
+        // the opcodes become the first ones after the gap
+        for (size_t i = p_gap0_; i > pos; --i)
+        {
+            const uint64_t op = p_buf_[i - 1];
+            p_pow0_ *= hashInverse;
+            p_hash0_ -= op * p_pow0_;
+            p_hash1_ = p_hash1_ * HASH_PRIME + op;
+        }
+        move_(pos, p_gap1_ - d, d);
+        p_gap0_ -= d;
+        p_gap1_ -= d;
+    }
+    else if (pos > p_gap0_)
+    {
+        const size_t d = pos - p_gap0_;
+        for (size_t i = p_gap1_; i < p_gap1_ + d; ++i)
+        {
+            const uint64_t op = p_buf_[i];
+            p_hash1_ = (p_hash1_ - op) * hashInverse;
+            p_hash0_ += op * p_pow0_;
+            p_pow0_ *= HASH_PRIME;
+        }
+        move_(p_gap1_, p_gap0_, d);
+        p_gap0_ += d;
+        p_gap1_ += d;
+    }
+}
+
+void BrainfCode::move_(size_t from, size_t to, size_t count)
+{
+    if (count == 0 || from == to)
+        return;
+
+    if (to < from)
+    {
+        std::copy(p_buf_.begin() + from, p_buf_.begin() + from + count,
+                  p_buf_.begin() + to);
+        std::copy(p_match_.begin() + from, p_match_.begin() + from + count,
+                  p_match_.begin() + to);
+    }
+    else
+    {
+        std::copy_backward(p_buf_.begin() + from, p_buf_.begin() + from + count,
+                           p_buf_.begin() + to + count);
+        std::copy_backward(p_match_.begin() + from, p_match_.begin() + from + count,
+                           p_match_.begin() + to + count);
+    }
+
+    // the moved range only overlaps gap, so a partner outside
+    // of it has not moved
+    for (size_t i = to; i < to + count; ++i)
+    {
+        const uint32_t m = p_match_[i];
+        if (m == NO_INDEX)
+            continue;
+        if (m >= from && m < from + count)
+            p_match_[i] = m - from + to;
+        else
+            p_match_[m] = i;
+    }
+}
+
+void BrainfCode::buildIndex_()
+{
+    p_match_.assign(p_buf_.size(), NO_INDEX);
+    std::vector<uint32_t> stack;
+    for (size_t i = 0; i < p_buf_.size(); ++i)
+    {
+        if (i == p_gap0_)
+            i = p_gap1_;
+        if (i >= p_buf_.size())
+            break;
+
+        if (p_buf_[i] == BFO_BEGIN)
+            stack.push_back(i);
+        else if (p_buf_[i] == BFO_END && !stack.empty())
+        {
+            p_match_[i] = stack.back();
+            p_match_[stack.back()] = i;
+            stack.pop_back();
+        }
+    }
+}
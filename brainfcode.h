@@ -0,0 +1,164 @@
+/** @file brainfcode.h
+
+    @brief Editable brainfuck code with a bracket index
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#ifndef BRAINFCODE_H
+#define BRAINFCODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "brainf.h"
+
+/** Opcodes in a gap buffer, for many small edits.
+
+    Inserting and erasing happens at the gap, which is moved to the
+    edit position first, so the cost is the distance to the previous
+    edit instead of the length of the code.
+
+    Matching brackets are indexed by their physical position in the
+    buffer, which only changes for the opcodes that the gap moves over,
+    so match() and erasing a loop need no search.
+    Unmatched brackets are allowed, e.g. from cutting code apart.
+
+    ops() returns the plain opcode vector, e.g. for Brainf::setCode(),
+    after close() moved the gap out of the way. Any edit reopens it,
+    copy() works either way.
+
+    The ranges of the edits since setUnchanged() are kept in changes(),
+    so a caller can redo its work on the code only around them.
+
+    hash() is the sum of opcode * P^position. The part before the gap
+    is kept with absolute positions and the part after it relative to
+    the gap, so inserting and erasing at the gap changes only one term
+    and moving the gap only the terms of the opcodes it passes.
+*/
+class BrainfCode
+{
+public:
+
+    /** Returned by match() for unmatched brackets and other opcodes */
+    static const size_t NO_MATCH = size_t(-1);
+
+    /** Range [begin, end) of changed opcodes. An empty range marks
+        the place of erased opcodes. */
+    struct Change
+    {
+        size_t begin, end;
+    };
+
+    BrainfCode();
+    explicit BrainfCode(const std::vector<BrainfOpcode>& code);
+
+    /** Replaces the code, builds the bracket index */
+    void assign(const std::vector<BrainfOpcode>& code);
+    void clear();
+
+    // ---------- getter -------------------
+
+    size_t size() const { return p_buf_.size() - (p_gap1_ - p_gap0_); }
+    bool empty() const { return size() == 0; }
+
+    BrainfOpcode operator[](size_t pos) const { return p_buf_[phys_(pos)]; }
+
+    /** Position of the bracket matching the one at @p pos, or NO_MATCH */
+    size_t match(size_t pos) const;
+
+    /** Returns true if the gap is closed and ops() can be used */
+    bool isClosed() const { return p_gap0_ == p_gap1_ && p_gap1_ == p_buf_.size(); }
+
+    /** The code as plain vector, only valid after close() */
+    const std::vector<BrainfOpcode>& ops() const { return p_buf_; }
+
+    /** Appends up to @p count opcodes from @p pos to @p code */
+    void copy(std::vector<BrainfOpcode>& code,
+              size_t pos = 0, size_t count = size_t(-1)) const;
+
+    /** Number of opcodes @p op in the code */
+    size_t count(BrainfOpcode op) const { return p_count_[op]; }
+
+    /** The edits since setUnchanged(), in order, touching ranges
+        are merged */
+    const std::vector<Change>& changes() const { return p_changes_; }
+
+    bool operator == (const BrainfCode& other) const;
+    bool operator != (const BrainfCode& other) const { return !(*this == other); }
+
+    /** Position-weighted hash of the code, kept up to date by each edit */
+    uint64_t hash() const { return p_hash0_ + p_pow0_ * p_hash1_; }
+
+    // ---------- editing ------------------
+
+    /** Moves the gap to the end and removes it from the buffer.
+        The memory is kept for the next edit. */
+    void close();
+
+    /** Replaces the opcode at @p pos.
+        Replacing or placing a bracket rebuilds the bracket index. */
+    void set(size_t pos, BrainfOpcode op);
+
+    /** Inserts @p op before @p pos, or appends for pos >= size().
+        Inserting a single bracket rebuilds the bracket index,
+        insertLoop() is the fast way. */
+    void insert(size_t pos, BrainfOpcode op);
+
+    /** Inserts '[' @p body ']' before @p pos */
+    void insertLoop(size_t pos, BrainfOpcode body);
+
+    /** Removes the opcode at @p pos, and for a bracket also
+        the matching one */
+    void erase(size_t pos);
+
+    /** Removes @p count opcodes from @p pos on.
+        Removing a bracket without its partner rebuilds the bracket index. */
+    void erase(size_t pos, size_t count);
+
+    /** Clears changes() */
+    void setUnchanged() { p_changes_.clear(); }
+
+private:
+
+    /** Physical index in p_buf_ of logical position @p pos */
+    size_t phys_(size_t pos) const
+        { return pos < p_gap0_ ? pos : pos + (p_gap1_ - p_gap0_); }
+
+    /** Makes the gap start at logical position @p pos and
+        be at least @p size long */
+    void openGap_(size_t pos, size_t size);
+
+    /** Moves @p count opcodes at physical @p from to @p to,
+        which must be gap, and fixes the bracket index */
+    void move_(size_t from, size_t to, size_t count);
+
+    /** Removes the opcode at @p pos without its matching bracket */
+    void eraseOne_(size_t pos);
+
+    void buildIndex_();
+
+    /** Adds the range of @p num new opcodes at @p pos to p_changes_,
+        after @p erased opcodes were replaced there */
+    void change_(size_t pos, size_t num, size_t erased);
+
+    /** Opcodes with the gap [p_gap0_, p_gap1_) in between */
+    std::vector<BrainfOpcode> p_buf_;
+    /** For each physical position the physical position of
+        the matching bracket, or NO_INDEX */
+    std::vector<uint32_t> p_match_;
+    size_t p_gap0_, p_gap1_;
+    /** Hash of the opcodes before the gap, hash of the opcodes after
+        the gap counted from the gap, and P^p_gap0_ */
+    uint64_t p_hash0_, p_hash1_, p_pow0_;
+    size_t p_count_[BFO_END + 1];
+    std::vector<Change> p_changes_;
+
+    static const uint32_t NO_INDEX = uint32_t(-1);
+};
+
+#endif // BRAINFCODE_H
@@ -0,0 +1,284 @@
+/** @file brainfdebugger.h
+
+    @brief Single stepping and reverse stepping of a brainfuck program
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#ifndef BRAINFDEBUGGER_H
+#define BRAINFDEBUGGER_H
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <string>
+
+#include "brainf.h"
+
+/** Cell type independent interface of BrainfDebugger.
+    Positions are opcode indices of Brainf::code(). */
+class BrainfDebuggerBase
+{
+public:
+    typedef std::ptrdiff_t Index;
+
+    virtual ~BrainfDebuggerBase() { }
+
+    // ---------------- getter -------------------
+
+    /** Number of steps since the start */
+    virtual size_t steps() const = 0;
+
+    virtual Index programPosition() const = 0;
+    virtual Index tapePosition() const = 0;
+    virtual Index codeLength() const = 0;
+
+    /** Returns true when the program counter moved past the last opcode */
+    bool isFinished() const { return programPosition() >= codeLength(); }
+
+    /** Returns the value of the cell at tape position @p pos as number,
+        or an empty string for cells that the program did not touch yet */
+    virtual std::string cellString(Index pos) const = 0;
+
+    virtual std::string outputString() const = 0;
+
+    // ------------- breakpoints -----------------
+
+    bool isBreakpoint(Index pos) const
+        { return pos >= 0 && pos < Index(p_break_.size()) && p_break_[pos]; }
+
+    void setBreakpoint(Index pos, bool enable)
+    {
+        if (pos >= Index(p_break_.size()))
+            p_break_.resize(pos + 1);
+        p_break_[pos] = enable;
+    }
+
+    void clearBreakpoints() { p_break_.clear(); }
+
+    // -------------- execute --------------------
+
+    /** Executes one opcode. Returns false if the program is finished
+        or stopped (waiting for input or at an infinite loop). */
+    virtual bool step() = 0;
+
+    /** Undoes the last step. Returns false at the start of the program. */
+    virtual bool stepBack() = 0;
+
+    /** Steps until the program counter reaches a breakpoint or @p stopAt,
+        the program stops or @p max_steps != 0 steps are done.
+        The opcode at the current position is always executed, so
+        repeated calls continue from a breakpoint.
+        Returns the number of steps. */
+    size_t run(size_t max_steps = 0, Index stopAt = -1);
+
+private:
+
+    std::vector<bool> p_break_;
+};
+
+
+/** Debugger for a Brainf<T>.
+
+    Each step is recorded in an undo log, which only holds the
+    program position, the previous cell value for opcodes that write
+    a cell and whether input was read. Pointer moves and output are
+    undone from the opcode itself. The log is limited in size, older
+    entries are dropped. Additionally, Brainf::snapshot()s of the
+    interpreter are kept every few thousand steps, which share the
+    unchanged tape pages. Stepping back beyond the log restores
+    the latest snapshot before the step and replays to it, which also
+    refills the log. The snapshots are thinned out when their number
+    exceeds the limit, so memory stays bounded however long the
+    program runs.
+*/
+template <typename T>
+class BrainfDebugger : public BrainfDebuggerBase
+{
+public:
+
+    /** Starts debugging at the state of @p bf.
+        @p logSize is the maximum number of undo entries,
+        @p snapshotInterval the initial number of steps between snapshots
+        of the interpreter and @p maxSnapshots the maximum number of them. */
+    explicit BrainfDebugger(const Brainf<T>& bf,
+                            size_t logSize = 1 << 16,
+                            size_t snapshotInterval = 1 << 12,
+                            size_t maxSnapshots = 64);
+
+    /** Read access to the interpreter */
+    const Brainf<T>& brainf() const { return p_bf_; }
+
+    size_t steps() const override { return p_steps_; }
+    Index programPosition() const override { return p_bf_.programPosition(); }
+    Index tapePosition() const override { return p_bf_.tapePosition(); }
+    Index codeLength() const override { return p_bf_.code().size(); }
+    std::string cellString(Index pos) const override;
+    std::string outputString() const override { return p_bf_.outputString(); }
+
+    bool step() override;
+    bool stepBack() override;
+
+private:
+
+    struct Undo
+    {
+        Index pc;
+        /** Cell value before +, - and , */
+        T cell;
+        /** ',' consumed input */
+        bool read;
+    };
+
+    struct Snapshot
+    {
+        size_t steps;
+        typename Brainf<T>::Snapshot state;
+    };
+
+    void addSnapshot_();
+
+    Brainf<T> p_bf_;
+    size_t p_steps_, p_logSize_, p_interval_, p_maxSnapshots_;
+    std::deque<Undo> p_log_;
+    std::vector<Snapshot> p_snapshots_;
+};
+
+
+
+
+// ############################## impl #################################
+
+
+inline size_t BrainfDebuggerBase::run(size_t max_steps, Index stopAt)
+{
+    size_t n = 0;
+    while (max_steps == 0 || n < max_steps)
+    {
+        if (!step())
+            break;
+        ++n;
+        if (programPosition() == stopAt || isBreakpoint(programPosition()))
+            break;
+    }
+    return n;
+}
+
+
+template <typename T>
+BrainfDebugger<T>::BrainfDebugger(const Brainf<T>& bf, size_t logSize,
+                                  size_t snapshotInterval, size_t maxSnapshots)
+    : p_bf_             (bf)
+    , p_steps_          (0)
+    , p_logSize_        (logSize)
+    , p_interval_       (std::max(size_t(1), snapshotInterval))
+    , p_maxSnapshots_   (std::max(size_t(2), maxSnapshots))
+{
+    // the start is always restorable
+    addSnapshot_();
+}
+
+template <typename T>
+std::string BrainfDebugger<T>::cellString(Index pos) const
+{
+    if (pos < p_bf_.tapeBegin() || pos >= p_bf_.tapeEnd())
+        return std::string();
+    return Brainf_traits<T>::toString(p_bf_.cell(pos));
+}
+
+template <typename T>
+void BrainfDebugger<T>::addSnapshot_()
+{
+    Snapshot s;
+    s.steps = p_steps_;
+    s.state = p_bf_.snapshot();
+    p_snapshots_.push_back(s);
+
+    if (p_snapshots_.size() > p_maxSnapshots_)
+    {
+        // keep the first and every second
+        size_t j = 1;
+        for (size_t i = 2; i < p_snapshots_.size(); i += 2)
+            p_snapshots_[j++] = p_snapshots_[i];
+        p_snapshots_.resize(j);
+        p_interval_ *= 2;
+    }
+}
+
+template <typename T>
+bool BrainfDebugger<T>::step()
+{
+    const Index pc = p_bf_.programPosition();
+    if (pc >= Index(p_bf_.code().size()))
+        return false;
+
+    Undo u;
+    u.pc = pc;
+    u.cell = T(0);
+    const BrainfOpcode op = p_bf_.code()[pc];
+    const Index inPos = p_bf_.inputPosition();
+    if (op == BFO_INC || op == BFO_DEC || op == BFO_IN)
+        u.cell = p_bf_.tapeAt(p_bf_.tapePosition());
+
+    if (!p_bf_.run(1).steps)
+        return false;
+
+    u.read = p_bf_.inputPosition() != inPos;
+    p_log_.push_back(u);
+    if (p_log_.size() > p_logSize_)
+        p_log_.pop_front();
+
+    ++p_steps_;
+    // snapshots of steps that were undone are still valid
+    if (p_steps_ >= p_snapshots_.back().steps + p_interval_)
+        addSnapshot_();
+    return true;
+}
+
+template <typename T>
+bool BrainfDebugger<T>::stepBack()
+{
+    if (p_steps_ == 0)
+        return false;
+
+    if (p_log_.empty())
+    {
+        // replay from the latest snapshot before the step
+        const size_t target = p_steps_ - 1;
+        size_t k = p_snapshots_.size() - 1;
+        while (p_snapshots_[k].steps > target)
+            --k;
+        p_bf_.restore(p_snapshots_[k].state);
+        p_steps_ = p_snapshots_[k].steps;
+        while (p_steps_ < target && step())
+            ;
+        return true;
+    }
+
+    const Undo u = p_log_.back();
+    p_log_.pop_back();
+
+    const Index tp = p_bf_.tapePosition();
+    switch (p_bf_.code()[u.pc])
+    {
+        default: break;
+        case BFO_LEFT: p_bf_.setTapePosition(tp + 1); break;
+        case BFO_RIGHT: p_bf_.setTapePosition(tp - 1); break;
+        case BFO_IN:
+            if (u.read)
+                p_bf_.setInputPosition(p_bf_.inputPosition() - 1);
+            // fall through
+        case BFO_INC:
+        case BFO_DEC: p_bf_.tapeAt(tp) = u.cell; break;
+        case BFO_OUT: p_bf_.truncateOutput(p_bf_.output().size() - 1); break;
+    }
+    p_bf_.setProgramPosition(u.pc);
+    --p_steps_;
+    return true;
+}
+
+
+#endif // BRAINFDEBUGGER_H
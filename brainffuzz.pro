@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# Differential fuzzing of the interpreter engines, no Qt dependency
+#
+# For a libFuzzer target (with clang):
+#   qmake brainffuzz.pro "DEFINES+=BRAINF_LIBFUZZER" \
+#       "QMAKE_CXXFLAGS+=-fsanitize=fuzzer" "QMAKE_LFLAGS+=-fsanitize=fuzzer"
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+TARGET = brainf-fuzz
+TEMPLATE = app
+
+
+SOURCES += fuzzmain.cpp
+
+HEADERS  += brainf.h \
+    brainfanalysis.h \
+    brainfprofile.h
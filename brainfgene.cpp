@@ -9,14 +9,26 @@
 */
 
 #include <cmath>
+#include <algorithm>
 
 #include "brainfgene.h"
+#include "brainfanalysis.h"
 #include "genepool.h"
 
 #define MAX_STEPS 500
+/** Tape of getBrainf(), it expands to the right and wraps around
+    on the left */
+#define TAPE_LENGTH 16
+#define TAPE_FLAGS (BFF_EXPAND_RIGHT | BFF_STOP_INFINITE)
+
+const size_t BrainfGene::NO_OUTPUT;
 
 BrainfGene::BrainfGene()
-    : enableLoops_      (true)
+    : target_           ("brainf***")
+    , maxSteps_         (MAX_STEPS)
+    , simple_           (true)
+    , tail_             (NO_OUTPUT)
+    , enableLoops_      (true)
 {
 }
 
@@ -29,7 +41,7 @@ BrainfGene * BrainfGene::clone() const
 std::string BrainfGene::toString() const
 {
     auto bf = getBrainf();
-    bf.run(MAX_STEPS);
+    bf.run(maxSteps_);
     return
             "{" + bf.outputString(true) + "} "
             + bf.codeString()
@@ -38,11 +50,13 @@ std::string BrainfGene::toString() const
 
 void BrainfGene::initialize()
 {
-    code_.clear();
+    std::vector<BrainfOpcode> code;
 
     const int si = pool()->rnd(4, 10);
     for (int i=0; i<si; ++i)
-        code_.push_back(rndOpcode_(false));
+        code.push_back(rndOpcode_(false));
+    code_.assign(code);
+    simple_ = false;
 }
 
 bool BrainfGene::operator == (const Gene * o) const
@@ -50,12 +64,7 @@ bool BrainfGene::operator == (const Gene * o) const
     const BrainfGene * other = dynamic_cast<const BrainfGene*>(o);
     if (!other)
         return false;
-    if (code_.size() != other->code_.size())
-        return false;
-    for (size_t i=0; i<code_.size(); ++i)
-        if (code_[i] != other->code_[i])
-            return false;
-    return true;
+    return code_ == other->code_;
 }
 
 void BrainfGene::mutate(double amt, double prob)
@@ -85,10 +94,10 @@ void BrainfGene::mutate(double amt, double prob)
         size_t i = pool()->rnd(0, int(code_.size()) - 1);
         if (   code_[i] != BFO_BEGIN
             && code_[i] != BFO_END)
-            code_[i] = rndOpcode_(false);
+            code_.set(i, rndOpcode_(false));
     }
 
-    simplify_(code_);
+    update_();
 }
 
 void BrainfGene::cross(const Gene * o)
@@ -103,85 +112,320 @@ void BrainfGene::cross(const Gene * o)
             x1 = pool()->rnd(int(other->code_.size()/3), int(other->code_.size()));
 
     /// @todo This does not check for matching loop brackets
-    code_.resize(x0);
-    for (size_t i = x1; i < other->code_.size(); ++i)
-        code_.push_back(other->code_[i]);
-
-    simplify_(code_);
+    std::vector<BrainfOpcode> code;
+    code_.copy(code, 0, x0);
+    code.resize(x0);
+    other->code_.copy(code, x1);
+
+    simplify_(code);
+    code_.assign(code);
+    truncate_();
+    code_.setUnchanged();
+    simple_ = true;
 }
 
-void BrainfGene::simplify_(std::vector<BrainfOpcode>& code)
+void BrainfGene::update_()
 {
-    if (code.empty())
+    if (!simple_)
+    {
+        std::vector<BrainfOpcode> code;
+        code_.copy(code);
+        simplify_(code);
+        // simplify_() only removes
+        if (code.size() != code_.size())
+            code_.assign(code);
+        truncate_();
+        code_.setUnchanged();
+        simple_ = true;
         return;
+    }
 
-    // remove leading tape moves
-    int i=0;
-    while (i < (int)code.size() &&
-           (code[i] == BFO_LEFT || code[i] == BFO_RIGHT))
-        ++i;
-    if (i>0)
-        code.erase(code.begin(), code.begin() + i);
+    // This is the stack pass of simplify_() done in place, the stack
+    // is the code before w and the input the code from w on.
+    // Around the changes the code is simplified already. Once the pass
+    // pushed an unchanged opcode, the top is the same as before and
+    // the following opcodes are pushed unchanged again, as long as
+    // something was written and no loop needs to be skipped for
+    // a zero cell. The pass then jumps to the next change.
+
+    const auto& changes = code_.changes();
+    // the first change that ends at or after pos
+    auto next = [&](size_t pos)
+    {
+        return std::lower_bound(changes.begin(), changes.end(), pos,
+                [](const BrainfCode::Change& c, size_t p) { return c.end < p; });
+    };
+
+    const size_t NONE = size_t(-1);
+    size_t w = 0;
+    // first '+', '-' or ',' on the stack, the ones before scanned have none
+    size_t firstWrite = NONE, scanned = 0;
+    auto written = [&]()
+    {
+        for (; firstWrite == NONE && scanned < w; ++scanned)
+        {
+            const BrainfOpcode op = code_[scanned];
+            if (op == BFO_INC || op == BFO_DEC || op == BFO_IN)
+                firstWrite = scanned;
+        }
+        return firstWrite != NONE;
+    };
+    // removes the top and the next input
+    auto pop = [&]()
+    {
+        code_.erase(--w, 2);
+        if (firstWrite == w)
+            firstWrite = NONE;
+        scanned = std::min(scanned, w);
+    };
+
+    bool synced = true;
+    for (;;)
+    {
+        if (synced)
+        {
+            const auto c = next(w);
+            if (c == changes.end())
+                break;
+            w = c->begin;
+            synced = false;
+        }
+        if (w >= code_.size())
+            break;
 
-    if (code.size() < 2)
-        return;
+        const BrainfOpcode op = code_[w],
+                           top = w ? code_[w - 1] : BFO_NOP;
+        const auto c = next(w + 1);
+        const bool changed = c != changes.end() && c->begin <= w;
+        const size_t m = code_.match(w);
+        bool push = true;
+        switch (op)
+        {
+            case BFO_LEFT:
+            case BFO_RIGHT:
+                // leading tape moves
+                if (w == 0)
+                {
+                    code_.erase(w, 1);
+                    push = false;
+                }
+                else if (top == (op == BFO_LEFT ? BFO_RIGHT : BFO_LEFT))
+                {
+                    pop();
+                    push = false;
+                }
+            break;
 
-    // keep everything up to last '.'
-    i = code.size() - 1;
-    for (; i > 0; --i)
-        if (code[i] == BFO_OUT)
+            case BFO_INC:
+            case BFO_DEC:
+                if (top == (op == BFO_INC ? BFO_DEC : BFO_INC))
+                {
+                    pop();
+                    push = false;
+                }
+            break;
+
+            case BFO_BEGIN:
+                // the loop is never entered on a zero cell
+                if (m != BrainfCode::NO_MATCH
+                    && (!written()
+                        || (top == BFO_END && code_.match(w - 1) != BrainfCode::NO_MATCH)))
+                {
+                    code_.erase(w, m - w + 1);
+                    push = false;
+                }
             break;
-    if (i > 0)
-    {
-        // but include trailing ']'
-        int j=i;
-        for (; j<int(code.size()); ++j)
-            if (code[j] == BFO_END)
-                i = j;
 
-        code.resize(std::min(code.size(), size_t(i + 1)));
+            case BFO_END:
+                // empty loop
+                if (m != BrainfCode::NO_MATCH && top == BFO_BEGIN)
+                {
+                    pop();
+                    push = false;
+                }
+            break;
+
+            default: break;
+        }
+
+        if (push)
+        {
+            ++w;
+            synced = !changed && written();
+        }
+    }
+
+    // the last output and the code after it are unchanged
+    if (!synced || tail_ == NO_OUTPUT || tail_ + w > code_.size())
+        truncate_();
+    code_.setUnchanged();
+}
+
+void BrainfGene::truncate_()
+{
+    tail_ = NO_OUTPUT;
+    // code without output is kept for evolution
+    if (!code_.count(BFO_OUT))
+        return;
+
+    size_t last = code_.size() - 1;
+    while (code_[last] != BFO_OUT)
+        --last;
+    // the outermost loop around it ends at the last ']'
+    // after it whose '[' is before it
+    size_t end = last + 1;
+    for (size_t i = last + 1; i < code_.size(); ++i)
+    if (code_[i] == BFO_END)
+    {
+        const size_t m = code_.match(i);
+        if (m != BrainfCode::NO_MATCH && m < last)
+            end = i + 1;
     }
+    code_.erase(end, code_.size() - end);
+    tail_ = end - 1 - last;
+}
 
-    if (code.size() < 2)
+void BrainfGene::simplify_(std::vector<BrainfOpcode>& code)
+{
+    if (code.empty())
         return;
 
-    for (size_t i = 0; i < code.size(); )
+    // scratch space, this is called for every new gene
+    thread_local std::vector<size_t> match, open;
+    thread_local std::vector<BrainfOpcode> out;
+    thread_local std::vector<bool> matched;
+
+    // match brackets, unmatched ones do nothing in the interpreter
+    // but are kept, a later cross() might complete them
+    match.assign(code.size(), size_t(-1));
+    open.clear();
+    for (size_t i = 0; i < code.size(); ++i)
     {
-        // remove obvious two-char noops
-        if (i < code.size() - 1)
+        if (code[i] == BFO_BEGIN)
+            open.push_back(i);
+        else if (code[i] == BFO_END && !open.empty())
         {
-            auto nextop = code[i+1];
-            if ((code[i] == BFO_INC && nextop == BFO_DEC)
-             || (code[i] == BFO_DEC && nextop == BFO_INC)
-             || (code[i] == BFO_RIGHT && nextop == BFO_LEFT)
-             || (code[i] == BFO_LEFT && nextop == BFO_RIGHT)
-             || (code[i] == BFO_BEGIN && nextop == BFO_END)
-                )
-            {
-                code.erase(code.begin() + i, code.begin() + i + 2);
-                continue;
-            }
+            match[i] = open.back();
+            match[open.back()] = i;
+            open.pop_back();
         }
+    }
+
+    // the output is a stack on which each opcode
+    // may cancel the previous one
+    out.clear();
+    // for each bracket in out if it is matched
+    matched.clear();
+    // number of '+', '-' and ',' in out, all cells are zero while there are none
+    size_t numWrites = 0;
+    auto push = [&](BrainfOpcode op, bool m) { out.push_back(op); matched.push_back(m); };
+    auto pop = [&]() { out.pop_back(); matched.pop_back(); };
+    for (size_t i = 0; i < code.size(); ++i)
+    {
+        const BrainfOpcode op = code[i],
+                           top = out.empty() ? BFO_NOP : out.back();
+        const bool topMatched = !out.empty() && matched.back();
+        switch (op)
+        {
+            case BFO_LEFT:
+            case BFO_RIGHT:
+                // leading tape moves
+                if (out.empty())
+                    break;
+                if (top == (op == BFO_LEFT ? BFO_RIGHT : BFO_LEFT))
+                    pop();
+                else
+                    push(op, false);
+            break;
 
-        ++i;
+            case BFO_INC:
+            case BFO_DEC:
+                if (top == (op == BFO_INC ? BFO_DEC : BFO_INC))
+                {
+                    pop();
+                    --numWrites;
+                }
+                else
+                {
+                    push(op, false);
+                    ++numWrites;
+                }
+            break;
+
+            case BFO_IN:
+                push(op, false);
+                ++numWrites;
+            break;
+
+            case BFO_BEGIN:
+                if (match[i] == size_t(-1))
+                    push(op, false);
+                // the loop is never entered on a zero cell,
+                // e.g. right after another loop
+                else if (numWrites == 0 || (top == BFO_END && topMatched))
+                    i = match[i];
+                else
+                    push(op, true);
+            break;
+
+            case BFO_END:
+                if (match[i] == size_t(-1))
+                    push(op, false);
+                // empty loop
+                else if (top == BFO_BEGIN)
+                    pop();
+                else
+                    push(op, true);
+            break;
+
+            default:
+                push(op, false);
+        }
+    }
+
+    // keep everything up to last '.', or the end of the loops
+    // around it, code without output is kept for evolution
+    size_t end = out.size();
+    while (end > 0 && out[end - 1] != BFO_OUT)
+        --end;
+    if (end > 0)
+    {
+        int depth = 0;
+        for (size_t i = 0; i < end; ++i)
+        if (matched[i])
+            depth += (out[i] == BFO_BEGIN) - (out[i] == BFO_END);
+        for (; depth > 0 && end < out.size(); ++end)
+        if (matched[end])
+            depth += (out[end] == BFO_BEGIN) - (out[end] == BFO_END);
+        out.resize(end);
     }
+
+    code.assign(out.begin(), out.end());
 }
 
 
 double BrainfGene::evaluate()
 {
+    // mutate() leaves the gap open, the analysis needs the plain code
+    code_.close();
 #if 1
-    auto bf = getBrainf();
-    bf.run(MAX_STEPS);
+    std::string str;
+    bool timeout = false;
+    // don't bother running code that never outputs
+    if (BrainfAnalysis(code_.ops(), maxSteps_,
+                       TAPE_LENGTH, TAPE_LENGTH, TAPE_FLAGS).canOutput())
+    {
+        auto bf = getBrainf();
+        timeout = bf.run(maxSteps_).status == BFR_STEP_LIMIT;
+        str = bf.outputString();
+    }
 
-    const std::string str = bf.outputString();
-    //double f = strCompare_(str, "Hello, world!");
-    //double f = strCompare_(str, "Hello, hello, hello, world!");
-    //double f = strCompare_(str, "abcabcabcabcabc");
-    //double f = strCompare_(str, "0123456789");
-    double f = strCompare_(str, "brainf***");
-    //double f = strCompare_(str, "words words words");
-    //double f = strCompare_(str, "Hello, world! brainfuck autogenerated code rulez!");
+    // e.g. "Hello, world!", "abcabcabcabcabc", "0123456789"
+    //      "Hello, world! brainfuck autogenerated code rulez!"
+    double f = strCompare_(str, target_);
+    // prefer programs that end over those cut off by the step limit
+    if (timeout)
+        f *= 0.75;
 #else
     auto bf = getBrainf(), bf2 = getBrainf();
     std::vector<unsigned char> inp;
@@ -200,14 +444,60 @@ double BrainfGene::evaluate()
     return f * 100.;
 }
 
+void BrainfGene::serialize(std::string &data) const
+{
+    writeValue_(data, uint32_t(code_.size()));
+    for (size_t i = 0; i < code_.size(); ++i)
+        data += char(code_[i]);
+    writeString_(data, target_);
+    writeValue_(data, uint64_t(maxSteps_));
+    writeValue_(data, uint8_t(enableLoops_));
+}
+
+bool BrainfGene::deserialize(const char *&data, const char *end)
+{
+    uint32_t size;
+    if (!readValue_(data, end, size) || end - data < (std::ptrdiff_t)size)
+        return false;
+    std::vector<BrainfOpcode> code;
+    for (uint32_t i=0; i<size; ++i)
+    {
+        if (data[i] < BFO_LEFT || data[i] > BFO_END)
+            return false;
+        code.push_back(BrainfOpcode(data[i]));
+    }
+    data += size;
+
+    uint64_t steps;
+    uint8_t loops;
+    if (!readString_(data, end, target_)
+        || !readValue_(data, end, steps)
+        || !readValue_(data, end, loops))
+        return false;
+
+    code_.assign(code);
+    simple_ = false;
+    maxSteps_ = steps;
+    enableLoops_ = loops;
+    return true;
+}
+
 Brainf_uint8 BrainfGene::getBrainf() const
 {
     std::vector<unsigned char> inp;
     for (int i=1; i<20; ++i)
         inp.push_back(i * 7);
 
-    Brainf_uint8 bf;
-    bf.setCode(code_);
+    Brainf_uint8 bf(TAPE_LENGTH, TAPE_LENGTH, TAPE_FLAGS);
+    bf.setEngine(BFE_OPTIMIZED);
+    if (code_.isClosed())
+        bf.setCode(code_.ops());
+    else
+    {
+        std::vector<BrainfOpcode> code;
+        code_.copy(code);
+        bf.setCode(code);
+    }
     bf.setInput(inp);
     return bf;
 }
@@ -258,13 +548,11 @@ void BrainfGene::addOpcode_()
     if (op == BFO_BEGIN || op == BFO_END)
     {
         /// @todo quite unsmart insert of a loop here
-        insert_(pos, BFO_END);
         // left,right,inc,dec,in (are all valid loop enders)
-        insert_(pos, BrainfOpcode(pool()->rnd(BFO_LEFT, BFO_IN)));
-        insert_(pos, BFO_BEGIN);
+        code_.insertLoop(pos, BrainfOpcode(pool()->rnd(BFO_LEFT, BFO_IN)));
     }
     else
-        insert_(pos, op);
+        code_.insert(pos, op);
 }
 
 void BrainfGene::removeOpcode_()
@@ -272,60 +560,6 @@ void BrainfGene::removeOpcode_()
     if (code_.size() < 2)
         return;
 
-    int pos = pool()->rnd(0, code_.size()-1);
-    if (code_[pos] != BFO_BEGIN
-     && code_[pos] != BFO_END)
-        code_.erase(code_.begin() + pos);
-    // remove begin and end statement
-    else if (code_[pos] == BFO_BEGIN)
-    {
-//        std::cout << "rem [ " << pos << std::endl;
-        code_.erase(code_.begin() + pos);
-
-        // find end bracket
-        size_t i = pos;
-        int lvl = 1;
-        while (i < code_.size())
-        {
-            if (code_[i] == BFO_BEGIN)
-                ++lvl;
-            else
-            if (code_[i] == BFO_END && --lvl == 0)
-            {
-                code_.erase(code_.begin() + i);
-                return;
-            }
-            ++i;
-        }
-//        std::cout << "not found ]" << std::endl;
-    }
-    else if (code_[pos] == BFO_END)
-    {
-//        std::cout << "rem ] " << pos << std::endl;
-        code_.erase(code_.begin() + pos);
-
-        // find start bracket
-        int i = pos, lvl = 1;
-        while (i >= 0)
-        {
-            --i;
-            if (code_[i] == BFO_END)
-                ++lvl;
-            else
-            if (code_[i] == BFO_BEGIN && (--lvl == 0))
-            {
-                code_.erase(code_.begin() + i);
-                return;
-            }
-        }
-//        std::cout << "not found [" << std::endl;
-    }
-}
-
-void BrainfGene::insert_(size_t pos, BrainfOpcode op)
-{
-    if (pos >= code_.size())
-        code_.push_back(op);
-    else
-        code_.insert(code_.begin() + pos, op);
+    // removes the matching bracket as well
+    code_.erase(pool()->rnd(0, code_.size()-1));
 }
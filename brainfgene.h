@@ -15,6 +15,7 @@
 
 #include "gene.h"
 #include "brainf.h"
+#include "brainfcode.h"
 
 class BrainfGene : public Gene
 {
@@ -29,27 +30,59 @@ public:
 
     void initialize() override;
     bool operator == (const Gene * other) const override;
+    uint64_t hash() const override { return code_.hash(); }
 
     void mutate(double amt, double prob) override;
     void cross(const Gene * other) override;
 
     double evaluate() override;
 
+    void serialize(std::string& data) const override;
+    bool deserialize(const char *& data, const char * end) override;
+
     /** Create a brainfuck interpreter with current code */
     Brainf_uint8 getBrainf() const;
 
+    // ------------- settings --------------
+
+    /** Sets the output string that evaluate() compares to */
+    void setTarget(const std::string& target) { target_ = target; }
+    const std::string& target() const { return target_; }
+
+    /** Sets the maximum number of steps for each program run */
+    void setMaxSteps(size_t steps) { maxSteps_ = steps; }
+    size_t maxSteps() const { return maxSteps_; }
+
 private:
 
     BrainfOpcode rndOpcode_(bool includeLoops);
     void addOpcode_();
     void removeOpcode_();
-    void insert_(size_t pos, BrainfOpcode op);
 
+    /** Rewrites @p code into a shorter canonical form with the same output.
+        Cancels '+-' and '<>' runs, removes leading tape moves, loops
+        that are empty or never entered and everything after the last
+        output. Applying it twice gives the same code. */
     void simplify_(std::vector<BrainfOpcode>&);
+    /** Simplifies code_ after changing it. Once the code is simplified
+        this only works around BrainfCode::changes(), which requires
+        that the edits keep the matching of the other brackets.
+        Must be called after changing code_ */
+    void update_();
+    /** Removes everything after the last output and the loops around it,
+        like simplify_(), and sets tail_ */
+    void truncate_();
 
     static double strCompare_(const std::string& a, const std::string& b);
 
-    std::vector<BrainfOpcode> code_;
+    BrainfCode code_;
+    std::string target_;
+    size_t maxSteps_;
+    /** code_ is in the form that simplify_() returns */
+    bool simple_;
+    /** Number of opcodes after the last output, NO_OUTPUT if there is none */
+    size_t tail_;
+    static const size_t NO_OUTPUT = size_t(-1);
 
     bool enableLoops_;
 };
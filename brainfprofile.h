@@ -0,0 +1,217 @@
+/** @file brainfprofile.h
+
+    @brief Execution profile of the brainfuck interpreter
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+// needs to come first, brainf.h includes this file after BrainfOpcode
+#include "brainf.h"
+
+#ifndef BRAINFPROFILE_H
+#define BRAINFPROFILE_H
+
+/** Execution counters collected by Brainf::run(size_t, BrainfProfile&).
+
+    The counters accumulate over several runs of the same code.
+    They are reset when the profile is used with code of another length.
+    Without a profile, the interpreter does not do any of the counting.
+*/
+struct BrainfProfile
+{
+    typedef std::ptrdiff_t Index;
+
+    BrainfProfile() { clear(); }
+
+    /** Number of executions per code position */
+    std::vector<uint64_t> code;
+    /** Number of times a loop was entered, at the position of '[' */
+    std::vector<uint64_t> loopEntries;
+    /** Number of iterations of a loop, at the position of '[' */
+    std::vector<uint64_t> loopIterations;
+    /** Number of cell accesses per tape position,
+        tape position 0 is at index tapeOffset */
+    std::vector<uint64_t> tape;
+    Index tapeOffset;
+    /** Number of tape resizes and cells added by them */
+    uint64_t tapeExpansions, tapeExpandedCells;
+    /** Number of bracket searches of the reference engine
+        and the opcodes scanned by them */
+    uint64_t bracketSearches, bracketSearchSteps;
+    /** Total number of processed opcodes */
+    uint64_t steps;
+
+    /** Resets all counters */
+    void clear();
+
+    /** Clears the counters if they do not fit the code length */
+    void prepare(size_t codeLength);
+
+    /** Increases the access count of tape position @p pos */
+    void countTape(Index pos)
+    {
+        Index i = pos + tapeOffset;
+        if (i < 0)
+        {
+            tape.insert(tape.begin(), -i, 0);
+            tapeOffset -= i;
+            i = 0;
+        }
+        else if (i >= Index(tape.size()))
+            tape.resize(i + 1);
+        ++tape[i];
+    }
+
+    // ------------- dumps ---------------
+
+    /** Returns the code with execution counts.
+        Consecutive opcodes with equal counts are printed in one line,
+        indented by the loop depth. Loops are annotated with
+        entries and iterations, followed by the tape and engine counters. */
+    std::string annotatedListing(const std::vector<BrainfOpcode>& code) const;
+
+    /** Returns the steps in the collapsed stack format that
+        flamegraph.pl and compatible tools read.
+        Each loop is a frame named after its position, e.g.
+        "program;loop@12;loop@40 1234", where the number are
+        the steps executed directly in the innermost loop. */
+    std::string foldedStacks(const std::vector<BrainfOpcode>& code) const;
+};
+
+
+
+// ############################## impl #################################
+
+
+inline void BrainfProfile::clear()
+{
+    code.clear();
+    loopEntries.clear();
+    loopIterations.clear();
+    tape.clear();
+    tapeOffset = 0;
+    tapeExpansions = tapeExpandedCells =
+    bracketSearches = bracketSearchSteps =
+    steps = 0;
+}
+
+inline void BrainfProfile::prepare(size_t codeLength)
+{
+    if (code.size() == codeLength)
+        return;
+    clear();
+    code.resize(codeLength);
+    loopEntries.resize(codeLength);
+    loopIterations.resize(codeLength);
+}
+
+inline std::string BrainfProfile::annotatedListing(
+        const std::vector<BrainfOpcode>& prog) const
+{
+    static const char opchar[] = "?<>+-,.[]";
+    std::stringstream s;
+
+    s << std::setw(12) << "count" << std::setw(8) << "pos" << "  code\n";
+
+    int depth = 0;
+    for (size_t i = 0; i < prog.size() && i < code.size(); )
+    {
+        if (prog[i] == BFO_END)
+            --depth;
+
+        // collect opcodes with same count, brackets get their own line
+        size_t j = i + 1;
+        if (prog[i] != BFO_BEGIN && prog[i] != BFO_END)
+            while (j < prog.size() && code[j] == code[i]
+                   && prog[j] != BFO_BEGIN && prog[j] != BFO_END)
+                ++j;
+
+        s << std::setw(12) << code[i] << std::setw(8) << i << "  "
+          << std::string(std::max(0, depth) * 4, ' ');
+        for (size_t k = i; k < j; ++k)
+            s << (prog[k] <= BFO_END ? opchar[prog[k]] : '?');
+        if (prog[i] == BFO_BEGIN)
+            s << "    entries " << loopEntries[i]
+              << ", iterations " << loopIterations[i];
+        s << "\n";
+
+        if (prog[i] == BFO_BEGIN)
+            ++depth;
+        i = j;
+    }
+
+    s << "\nsteps " << steps
+      << ", tape expansions " << tapeExpansions
+      << " (" << tapeExpandedCells << " cells)"
+      << ", bracket searches " << bracketSearches
+      << " (" << bracketSearchSteps << " opcodes scanned)\n";
+
+    s << "\ntape accesses\n";
+    for (size_t i = 0; i < tape.size(); ++i)
+        if (tape[i])
+            s << std::setw(12) << tape[i] << std::setw(8) << (Index(i) - tapeOffset) << "\n";
+
+    return s.str();
+}
+
+inline std::string BrainfProfile::foldedStacks(
+        const std::vector<BrainfOpcode>& prog) const
+{
+    std::stringstream s;
+
+    // frame names of open loops and the self count per frame
+    std::vector<std::string> frames(1, "program");
+    std::vector<uint64_t> counts(1, 0);
+
+    auto flush = [&]()
+    {
+        if (!counts.back())
+            return;
+        for (size_t k = 0; k < frames.size(); ++k)
+            s << (k ? ";" : "") << frames[k];
+        s << " " << counts.back() << "\n";
+    };
+
+    for (size_t i = 0; i < prog.size() && i < code.size(); ++i)
+    {
+        if (prog[i] == BFO_BEGIN)
+        {
+            // '[' counts to the enclosing frame
+            counts.back() += code[i];
+            frames.push_back("loop@" + std::to_string(i));
+            counts.push_back(0);
+        }
+        else if (prog[i] == BFO_END && frames.size() > 1)
+        {
+            counts.back() += code[i];
+            flush();
+            frames.pop_back();
+            counts.pop_back();
+        }
+        else
+            counts.back() += code[i];
+    }
+    // unclosed loops and main program
+    while (!frames.empty())
+    {
+        flush();
+        frames.pop_back();
+        counts.pop_back();
+    }
+
+    return s.str();
+}
+
+
+#endif // BRAINFPROFILE_H
@@ -0,0 +1,253 @@
+/** @file brainfscheduler.h
+
+    @brief Many interactive brainfuck programs on one thread
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#ifndef BRAINFSCHEDULER_H
+#define BRAINFSCHEDULER_H
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+
+#include "brainf.h"
+
+/** Runs many Brainf programs in turns on the calling thread.
+
+    A Brainf can be stopped anywhere and continued with run(), so each
+    program simply runs for a number of steps (the quantum) before it
+    goes to the back of the queue. BFF_WAIT_INPUT is set for all programs,
+    a program that runs out of input leaves the queue until feed() or
+    closeInput() is called for it, so waiting programs cost nothing.
+
+    After each turn the new output is passed to the output callback and
+    cleared from the interpreter, so output arrives in chunks of at most
+    one quantum of steps. A program that reached the end of its code or
+    stopped at an infinite loop (with BFF_STOP_INFINITE) is passed to the
+    finish callback and removed.
+
+    The callbacks may call any method of the scheduler.
+*/
+template <typename T>
+class BrainfScheduler
+{
+public:
+
+    /** Identifies a program, ids are not reused */
+    typedef size_t Id;
+
+    typedef std::function<void(Id id, const std::vector<T>& output)> OutputCallback;
+    typedef std::function<void(Id id, const Brainf<T>& bf)> FinishCallback;
+
+    /** @p quantum is the number of steps of a turn */
+    explicit BrainfScheduler(size_t quantum = 1 << 14)
+        : p_quantum_    (std::max(size_t(1), quantum))
+        , p_next_       (0)
+        , p_steps_      (0)
+    { }
+
+    // ---------------- getter -------------------
+
+    size_t quantum() const { return p_quantum_; }
+
+    /** Number of programs, running or waiting for input */
+    size_t numPrograms() const { return p_tasks_.size(); }
+
+    /** Number of programs that can run */
+    size_t numReady() const { return p_ready_.size(); }
+
+    /** Returns true when no program can run */
+    bool isIdle() const { return p_ready_.empty(); }
+
+    /** Number of steps of all programs so far */
+    size_t steps() const { return p_steps_; }
+
+    /** Returns true if program @p id has not finished or been removed */
+    bool contains(Id id) const { return p_tasks_.count(id) != 0; }
+
+    /** Returns the interpreter of program @p id, or 0 if it is unknown */
+    const Brainf<T> * brainf(Id id) const
+        { auto i = p_tasks_.find(id); return i == p_tasks_.end() ? 0 : &i->second.bf; }
+
+    // ---------------- setter -------------------
+
+    void setQuantum(size_t steps) { p_quantum_ = std::max(size_t(1), steps); }
+    void setOutputCallback(OutputCallback f) { p_onOutput_ = f; }
+    void setFinishCallback(FinishCallback f) { p_onFinish_ = f; }
+
+    /** Adds a copy of @p bf, which continues at its current state.
+        Returns the id of the program. */
+    Id add(const Brainf<T>& bf);
+
+    /** Removes program @p id without calling the finish callback */
+    void remove(Id id);
+
+    /** Appends to the input of program @p id and wakes it up */
+    void feed(Id id, const std::vector<T>& input);
+    void feed(Id id, const std::string& input) { feed(id, Brainf<T>::fromString(input)); }
+
+    /** Ends the input of program @p id, it reads 0 from now on */
+    void closeInput(Id id);
+
+    // -------------- execute --------------------
+
+    /** Gives the next program in the queue its turn.
+        Returns the number of steps, or 0 when idle. */
+    size_t runNext();
+
+    /** Gives turns to the programs until all are waiting or finished,
+        or @p max_steps != 0 steps are done.
+        Returns the number of steps. */
+    size_t run(size_t max_steps = 0);
+
+private:
+
+    struct Task
+    {
+        Brainf<T> bf;
+        /** In p_ready_ */
+        bool ready;
+    };
+
+    void wake_(Id id, Task& t);
+
+    size_t p_quantum_;
+    Id p_next_;
+    size_t p_steps_;
+    std::unordered_map<Id, Task> p_tasks_;
+    std::deque<Id> p_ready_;
+    OutputCallback p_onOutput_;
+    FinishCallback p_onFinish_;
+};
+
+
+
+
+// ############################## impl #################################
+
+
+template <typename T>
+typename BrainfScheduler<T>::Id BrainfScheduler<T>::add(const Brainf<T>& bf)
+{
+    const Id id = p_next_++;
+    Task& t = p_tasks_[id];
+    t.bf = bf;
+    t.bf.setFlags(t.bf.flags() | BFF_WAIT_INPUT);
+    t.ready = false;
+    wake_(id, t);
+    return id;
+}
+
+template <typename T>
+void BrainfScheduler<T>::remove(Id id)
+{
+    auto i = p_tasks_.find(id);
+    if (i == p_tasks_.end())
+        return;
+    if (i->second.ready)
+        p_ready_.erase(std::find(p_ready_.begin(), p_ready_.end(), id));
+    p_tasks_.erase(i);
+}
+
+template <typename T>
+void BrainfScheduler<T>::feed(Id id, const std::vector<T>& input)
+{
+    auto i = p_tasks_.find(id);
+    if (i == p_tasks_.end())
+        return;
+    i->second.bf.appendInput(input);
+    wake_(id, i->second);
+}
+
+template <typename T>
+void BrainfScheduler<T>::closeInput(Id id)
+{
+    auto i = p_tasks_.find(id);
+    if (i == p_tasks_.end())
+        return;
+    Brainf<T>& bf = i->second.bf;
+    bf.setFlags(bf.flags() & ~BFF_WAIT_INPUT);
+    wake_(id, i->second);
+}
+
+template <typename T>
+void BrainfScheduler<T>::wake_(Id id, Task& t)
+{
+    if (t.ready)
+        return;
+    t.ready = true;
+    p_ready_.push_back(id);
+}
+
+template <typename T>
+size_t BrainfScheduler<T>::runNext()
+{
+    if (p_ready_.empty())
+        return 0;
+
+    const Id id = p_ready_.front();
+    p_ready_.pop_front();
+    // an unordered_map keeps the references to its elements
+    // when it grows, so t stays valid unless id is removed
+    Task * t = &p_tasks_[id];
+    t->ready = false;
+
+    const BrainfRunResult r = t->bf.run(p_quantum_);
+    const size_t steps = r.steps;
+    p_steps_ += steps;
+
+    if (!t->bf.output().empty())
+    {
+        const std::vector<T> out = t->bf.output();
+        t->bf.clearOutput();
+        if (p_onOutput_)
+        {
+            p_onOutput_(id, out);
+            auto i = p_tasks_.find(id);
+            if (i == p_tasks_.end())
+                return steps;
+            t = &i->second;
+        }
+    }
+
+    if (r.status == BFR_FINISHED || r.status == BFR_INFINITE)
+    {
+        if (t->ready)
+            p_ready_.erase(std::find(p_ready_.begin(), p_ready_.end(), id));
+        if (p_onFinish_)
+        {
+            // the finish callback sees the complete state
+            const Brainf<T> done = std::move(t->bf);
+            p_tasks_.erase(id);
+            p_onFinish_(id, done);
+        }
+        else
+            p_tasks_.erase(id);
+    }
+    else if (r.status != BFR_WAIT_INPUT)
+        wake_(id, *t);
+
+    return steps;
+}
+
+template <typename T>
+size_t BrainfScheduler<T>::run(size_t max_steps)
+{
+    size_t steps = 0;
+    while (!p_ready_.empty() && (max_steps == 0 || steps < max_steps))
+        steps += runNext();
+    return steps;
+}
+
+
+#endif // BRAINFSCHEDULER_H
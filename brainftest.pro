@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# Headless tests, no Qt dependency
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG += console c++11 thread
+CONFIG -= app_bundle qt
+
+TARGET = brainf-test
+TEMPLATE = app
+
+
+SOURCES += testmain.cpp \
+    gene.cpp \
+    genepool.cpp \
+    brainfgene.cpp \
+    brainfcode.cpp \
+    geneevaluator.cpp
+
+HEADERS  += brainf.h \
+    brainfanalysis.h \
+    brainfprofile.h \
+    brainfscheduler.h \
+    gene.h \
+    genepool.h \
+    brainfgene.h \
+    brainfcode.h \
+    geneevaluator.h
@@ -0,0 +1,354 @@
+/** @file brainfthread.cpp
+
+    @brief Runs a brainfuck program in a background thread
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#include <chrono>
+
+#include "brainfthread.h"
+#include "brainf.h"
+
+/** Number of steps between checks for cancellation */
+#define CHUNK_STEPS 65536
+/** Milliseconds between progress signals */
+#define PROGRESS_INTERVAL 100
+/** Milliseconds between output signals */
+#define OUTPUT_INTERVAL 40
+/** Output size that is sent regardless of OUTPUT_INTERVAL */
+#define OUTPUT_MAX_BATCH (1 << 16)
+/** Initial number of steps between snapshots */
+#define SNAPSHOT_STEPS (1 << 22)
+/** Maximum number of snapshots, every second one is dropped
+    and the interval is doubled when exceeded */
+#define MAX_SNAPSHOTS 32
+/** Output size up to which snapshots are taken */
+#define MAX_CACHED_OUTPUT (1 << 20)
+
+
+/** The compiled program and snapshots of one cell type */
+template <typename T>
+struct BrainfThread::Cache : public BrainfThread::CacheBase
+{
+    typedef typename Brainf<T>::Index Index;
+
+    struct Snapshot
+    {
+        /** Interpreter state, shares unchanged tape pages with the others */
+        typename Brainf<T>::Snapshot state;
+        size_t steps;
+        /** Number of output values up to the snapshot */
+        size_t outputLength;
+    };
+
+    Cache() : interval(SNAPSHOT_STEPS) { }
+
+    /** Brings the program and snapshots up to date with new code and input.
+        Snapshots that depend on changed code or input are dropped.
+        The first snapshot is the state before the first step
+        and is always kept. */
+    void update(const std::string& codeStr, const std::string& inputStr);
+
+    /** Adds a snapshot of @p bf, if the output is not too large */
+    void add(Brainf<T>& bf, size_t steps);
+
+    /** For each position, true for a '[' with a matching ']' */
+    static std::vector<bool> matchedBegins_(const std::vector<BrainfOpcode>& code);
+
+    /** The compiled program with the current code and input,
+        the snapshots are restored into a copy of it */
+    Brainf<T> bf;
+    std::vector<BrainfOpcode> code;
+    std::string input,
+    /** Output of the program up to MAX_CACHED_OUTPUT */
+        output;
+    std::vector<Snapshot> snapshots;
+    size_t interval;
+};
+
+template <typename T>
+void BrainfThread::Cache<T>::update(const std::string& codeStr, const std::string& inputStr)
+{
+    const auto ncode = Brainf<T>::parseCode(codeStr);
+
+    if (snapshots.empty())
+    {
+        bf.setEngine(BFE_JUMPTABLE);
+        bf.setCode(ncode);
+        bf.setInput(inputStr);
+        bf.compile();
+        Snapshot s;
+        s.state = bf.snapshot();
+        s.steps = s.outputLength = 0;
+        snapshots.push_back(s);
+        code = ncode;
+        input = inputStr;
+        return;
+    }
+
+    // first and last difference of the code
+    const Index num = std::min(code.size(), ncode.size());
+    Index d = 0, suffix = 0;
+    while (d < num && code[d] == ncode[d])
+        ++d;
+    while (suffix < num - d
+           && code[code.size() - 1 - suffix] == ncode[ncode.size() - 1 - suffix])
+        ++suffix;
+    // code is unchanged
+    if (d == Index(code.size()) && d == Index(ncode.size()))
+        d = std::numeric_limits<Index>::max();
+    else
+    {
+        // a '[' before d that gains or loses its matching bracket
+        // behaves differently, the change starts there
+        const std::vector<bool>
+                oldMatched = matchedBegins_(code),
+                newMatched = matchedBegins_(ncode);
+        for (Index i = 0; i < d; ++i)
+            if (oldMatched[i] != newMatched[i])
+            {
+                d = i;
+                break;
+            }
+    }
+
+    size_t inp = 0;
+    while (inp < input.size() && inp < inputStr.size() && input[inp] == inputStr[inp])
+        ++inp;
+
+    // a snapshot at the end of the input may have read zeros
+    // past it, which longer input would have replaced
+    const bool sameInput = inp == input.size() && inp == inputStr.size();
+
+    // keep snapshots that did not see the changes, like
+    // Brainf::maxExecutedPosition() does for the interpreter,
+    // they are ordered by steps so the valid ones come first
+    size_t k = 1;
+    while (k < snapshots.size()
+           && std::max(snapshots[k].state.codeHighWater,
+                       snapshots[k].state.codePos - 1) < d
+           && size_t(snapshots[k].state.inputPos) <= inp
+           && (sameInput || size_t(snapshots[k].state.inputPos) < input.size()))
+        ++k;
+    snapshots.resize(k);
+
+    // the program counters of the kept snapshots are before d,
+    // so they stay the same with the new code
+    if (d != std::numeric_limits<Index>::max())
+    {
+        const std::vector<BrainfOpcode> patch(ncode.begin() + d, ncode.end() - suffix);
+        bf.replaceCode(d, code.size() - d - suffix, patch);
+        bf.compile();
+    }
+    if (!sameInput)
+        bf.setInput(inputStr);
+
+    output.resize(snapshots.back().outputLength);
+    code = ncode;
+    input = inputStr;
+}
+
+template <typename T>
+std::vector<bool> BrainfThread::Cache<T>::matchedBegins_(const std::vector<BrainfOpcode>& code)
+{
+    std::vector<bool> matched(code.size(), false);
+    std::vector<size_t> stack;
+    for (size_t i = 0; i < code.size(); ++i)
+    {
+        if (code[i] == BFO_BEGIN)
+            stack.push_back(i);
+        else if (code[i] == BFO_END && !stack.empty())
+        {
+            matched[stack.back()] = true;
+            stack.pop_back();
+        }
+    }
+    return matched;
+}
+
+template <typename T>
+void BrainfThread::Cache<T>::add(Brainf<T>& bf, size_t steps)
+{
+    if (output.size() >= MAX_CACHED_OUTPUT)
+        return;
+
+    Snapshot s;
+    s.state = bf.snapshot();
+    s.steps = steps;
+    s.outputLength = output.size();
+    snapshots.push_back(s);
+
+    if (snapshots.size() > MAX_SNAPSHOTS)
+    {
+        // keep the first, the last and every second
+        size_t j = 1;
+        for (size_t i = 2; i < snapshots.size() - 1; i += 2)
+            snapshots[j++] = snapshots[i];
+        snapshots[j++] = snapshots.back();
+        snapshots.resize(j);
+        interval *= 2;
+    }
+}
+
+
+
+BrainfThread::BrainfThread(QObject * parent)
+    : QThread   (parent)
+    , p_id_     (0)
+    , p_cancel_ (false)
+{
+}
+
+BrainfThread::~BrainfThread()
+{
+    cancel();
+    wait();
+}
+
+int BrainfThread::startProgram(const Settings& s)
+{
+    // stop previous run, it checks the flag at least every CHUNK_STEPS
+    cancel();
+    wait();
+
+    p_set_ = s;
+    p_cancel_ = false;
+    ++p_id_;
+    start();
+    return p_id_;
+}
+
+void BrainfThread::run()
+{
+    switch (p_set_.dataSize)
+    {
+        case 8:
+            if (p_set_.saturate)
+                p_set_.signedData ? runBf_<Brainf_saturated<int8_t>>()
+                                  : runBf_<Brainf_saturated<u_int8_t>>();
+            else
+                p_set_.signedData ? runBf_<int8_t>() : runBf_<u_int8_t>();
+        break;
+
+        case 16:
+            if (p_set_.saturate)
+                p_set_.signedData ? runBf_<Brainf_saturated<int16_t>>()
+                                  : runBf_<Brainf_saturated<u_int16_t>>();
+            else
+                p_set_.signedData ? runBf_<int16_t>() : runBf_<u_int16_t>();
+        break;
+
+        case 32:
+            if (p_set_.saturate)
+                p_set_.signedData ? runBf_<Brainf_saturated<int32_t>>()
+                                  : runBf_<Brainf_saturated<u_int32_t>>();
+            else
+                p_set_.signedData ? runBf_<int32_t>() : runBf_<u_int32_t>();
+        break;
+
+        case 64:
+            if (p_set_.saturate)
+                p_set_.signedData ? runBf_<Brainf_saturated<int64_t>>()
+                                  : runBf_<Brainf_saturated<u_int64_t>>();
+            else
+                p_set_.signedData ? runBf_<int64_t>() : runBf_<u_int64_t>();
+        break;
+
+        case 128:
+            runBf_<Brainf_bignum>();
+        break;
+    }
+}
+
+template <typename T>
+void BrainfThread::runBf_()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    auto cache = dynamic_cast<Cache<T>*>(p_cache_.get());
+    if (!cache)
+        p_cache_.reset(cache = new Cache<T>);
+    cache->update(p_set_.code, p_set_.input);
+
+    // resume from the latest snapshot within the step limit
+    auto& snapshots = cache->snapshots;
+    size_t k = snapshots.size() - 1;
+    while (k > 0 && p_set_.maxSteps && snapshots[k].steps > p_set_.maxSteps)
+        --k;
+    snapshots.resize(k + 1);
+    cache->output.resize(snapshots[k].outputLength);
+
+    Brainf<T> bf = cache->bf;
+    bf.restore(snapshots[k].state);
+    const auto num = (typename Brainf<T>::Index)bf.code().size();
+    const int id = p_id_;
+    size_t steps = snapshots[k].steps,
+           outputLength = cache->output.size(),
+           nextSnapshot = steps + cache->interval;
+    std::string pending = cache->output;
+    auto lastProgress = Clock::now(),
+         // send first output immediately
+         lastOutput = lastProgress - std::chrono::milliseconds(OUTPUT_INTERVAL);
+
+    auto sendOutput = [&]()
+    {
+        emit output(id, QString::fromStdString(pending));
+        pending.clear();
+    };
+
+    while (bf.programPosition() < num
+           && (p_set_.maxSteps == 0 || steps < p_set_.maxSteps))
+    {
+        if (p_cancel_)
+        {
+            // the edit that cancelled us most likely comes after this point
+            cache->add(bf, steps);
+            return;
+        }
+
+        size_t chunk = CHUNK_STEPS;
+        if (p_set_.maxSteps)
+            chunk = std::min(chunk, p_set_.maxSteps - steps);
+        steps += bf.run(chunk).steps;
+
+        if (!bf.output().empty())
+        {
+            const std::string out = bf.outputString();
+            bf.clearOutput();
+            outputLength += out.size();
+            pending += out;
+            if (cache->output.size() < MAX_CACHED_OUTPUT)
+                cache->output += out;
+        }
+
+        if (steps >= nextSnapshot)
+        {
+            cache->add(bf, steps);
+            nextSnapshot = steps + cache->interval;
+        }
+
+        const auto now = Clock::now();
+        if (!pending.empty()
+            && (now - lastOutput > std::chrono::milliseconds(OUTPUT_INTERVAL)
+                || pending.size() >= OUTPUT_MAX_BATCH))
+        {
+            lastOutput = now;
+            sendOutput();
+        }
+        if (now - lastProgress > std::chrono::milliseconds(PROGRESS_INTERVAL))
+        {
+            lastProgress = now;
+            emit progress(id, steps, outputLength);
+        }
+    }
+
+    if (steps > snapshots.back().steps)
+        cache->add(bf, steps);
+    if (!pending.empty())
+        sendOutput();
+    emit programFinished(id, steps, bf.programPosition() >= num);
+}
@@ -0,0 +1,106 @@
+/** @file brainfthread.h
+
+    @brief Runs a brainfuck program in a background thread
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#ifndef BRAINFTHREAD_H
+#define BRAINFTHREAD_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <QThread>
+#include <QString>
+
+/** Executes a brainfuck program off the UI thread.
+
+    The program is executed in small chunks of steps, between which
+    the cancellation flag is checked, so a stale run stops almost
+    immediately when a new one is started.
+    The output is sent in batches while the program runs.
+
+    The thread keeps the compiled program of the last run together
+    with snapshots of the interpreter taken every few million steps.
+    When the next program differs only after the code that a snapshot
+    has executed, and the input that it has read is unchanged,
+    the run resumes from the latest such snapshot. The snapshots hold
+    only the interpreter state and share unchanged tape pages, the
+    compiled program is patched in place for each edit. Resuming
+    re-sends the output up to the snapshot, so the output is only
+    kept up to a limited size; programs with more output
+    always restart from an earlier snapshot.
+    All signals carry the id returned by startProgram() so that
+    queued signals of a cancelled run can be ignored.
+*/
+class BrainfThread : public QThread
+{
+    Q_OBJECT
+
+public:
+
+    /** Settings for one run */
+    struct Settings
+    {
+        Settings()
+            : dataSize(8), signedData(false), saturate(false), maxSteps(1000000) { }
+        std::string code, input;
+        /** Cell size in bits, 128 selects Brainf_bignum */
+        int dataSize;
+        bool signedData, saturate;
+        /** Step limit, 0 for unlimited */
+        size_t maxSteps;
+    };
+
+    explicit BrainfThread(QObject * parent = 0);
+    /** Cancels and waits for a running program */
+    ~BrainfThread();
+
+    /** Starts running the program with the given settings.
+        A running program is cancelled first.
+        Returns the id of the new run. */
+    int startProgram(const Settings& s);
+
+    /** Requests the current run to stop, returns immediately */
+    void cancel() { p_cancel_ = true; }
+
+signals:
+
+    /** Emitted periodically during a run */
+    void progress(int id, qulonglong steps, qulonglong outputLength);
+
+    /** Emitted with the new output since the last signal.
+        Output is batched, this is sent at most every few milliseconds. */
+    void output(int id, const QString& output);
+
+    /** Emitted when a run is complete, after the last output().
+        @p steps is the number of processed opcodes and @p complete
+        is false if the step limit was reached. Cancelled runs
+        do not emit this signal. */
+    void programFinished(int id, qulonglong steps, bool complete);
+
+protected:
+
+    void run() override;
+
+private:
+
+    template <typename T>
+    void runBf_();
+
+    struct CacheBase { virtual ~CacheBase() { } };
+    template <typename T> struct Cache;
+
+    Settings p_set_;
+    /** Snapshots of the last run, only accessed by the thread */
+    std::unique_ptr<CacheBase> p_cache_;
+    int p_id_;
+    std::atomic<bool> p_cancel_;
+};
+
+#endif // BRAINFTHREAD_H
@@ -0,0 +1,568 @@
+/** @file climain.cpp
+
+    @brief Headless command line runner, without Qt dependency
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+
+#include <unistd.h>
+
+#include "brainf.h"
+#include "genepool.h"
+#include "brainfgene.h"
+#include "geneevaluator.h"
+
+namespace {
+
+struct Options
+{
+    Options()
+        : engine        (BFE_JUMPTABLE)
+        , cell          ("uint8")
+        , maxSteps      (0)
+        , numbers       (false)
+        , stopInfinite  (false)
+        , waitInput     (true)
+        , stats         (false)
+        , analyze       (false)
+        , profileFolded (false)
+        , ga            (false)
+        , target        ("brainf***")
+        , population    (100)
+        , generations   (0)
+        , fitness       (99.99999)
+        , dumpEvery     (1000)
+        , dumpCount     (20)
+        , geneSteps     (500)
+        , checkpointEvery (1000)
+        , processes     (0)
+        , islands       (1)
+    { }
+
+    std::string code;
+    BrainfEngine engine;
+    std::string cell;
+    size_t maxSteps;
+    bool numbers, stopInfinite, waitInput, stats, analyze;
+    std::string profileFile;
+    bool profileFolded;
+
+    bool ga;
+    std::string target;
+    size_t population, generations;
+    double fitness;
+    size_t dumpEvery, dumpCount, geneSteps;
+    std::string checkpoint;
+    size_t checkpointEvery, processes, islands;
+};
+
+void printUsage(std::ostream& out)
+{
+    out <<
+    "usage: brainf-cli [options] [file.bf]\n"
+    "\n"
+    "Runs a brainfuck program from file.bf (or --code), streaming\n"
+    "the input from stdin and the output to stdout.\n"
+    "\n"
+    "  -c, --code CODE       program text instead of a file\n"
+    "  -e, --engine NAME     reference, jumptable (default), optimized\n"
+    "  -t, --cell TYPE       uint8 (default), int8, uint16, int16, uint32, int32,\n"
+    "                        uint64, int64, uint8_sat, int8_sat, uint16_sat,\n"
+    "                        int16_sat, uint32_sat, int32_sat, uint64_sat,\n"
+    "                        int64_sat, big\n"
+    "  -s, --max-steps N     stop after N opcodes (default 0 = unlimited)\n"
+    "  -n, --numbers         print output as comma separated numbers\n"
+    "      --stop-infinite   stop at loops that provably never terminate\n"
+    "      --no-wait         don't wait for stdin, input is 0 when consumed\n"
+    "      --stats           print steps and timing to stderr\n"
+    "      --analyze         print the static analysis instead of running\n"
+    "      --profile FILE    write an annotated execution profile to FILE\n"
+    "      --folded          write the profile in flamegraph collapsed format\n"
+    "\n"
+    "  -g, --ga              run the genetic algorithm instead\n"
+    "      --target STR      output to evolve (default \"brainf***\")\n"
+    "      --population N    number of genes (default 100)\n"
+    "      --generations N   stop after N generations (default 0 = unlimited)\n"
+    "      --fitness F       stop when best fitness reaches F (default 99.99999)\n"
+    "      --dump-every N    dump the pool every N generations (default 1000)\n"
+    "      --dump N          number of genes to dump (default 20)\n"
+    "      --gene-steps N    max steps per gene evaluation (default 500)\n"
+    "      --checkpoint FILE resume from FILE if it exists and save the pool to it\n"
+    "      --checkpoint-every N  save every N generations (default 1000)\n"
+    "      --processes N     evaluate in N worker processes (default 0 = in-process)\n"
+    "      --islands N       breed N islands in threads pinned to NUMA nodes (default 1)\n"
+    "\n"
+    "  -h, --help            show this help\n";
+}
+
+bool readFile(const std::string& fn, std::string& content)
+{
+    std::ifstream f(fn, std::ios::binary);
+    if (!f)
+        return false;
+    std::stringstream s;
+    s << f.rdbuf();
+    content = s.str();
+    return true;
+}
+
+/** Parses the command line into @p o.
+    Returns -1 to continue, otherwise the exit code */
+int parseArgs(int argc, char* argv[], Options& o)
+{
+    std::string file;
+    bool haveCode = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+        // option with argument
+        auto arg = [&](std::string& v) -> bool
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "missing argument for " << a << std::endl;
+                return false;
+            }
+            v = argv[++i];
+            return true;
+        };
+        std::string v;
+
+        if (a == "-h" || a == "--help")
+        {
+            printUsage(std::cout);
+            return 0;
+        }
+        else if (a == "-c" || a == "--code")
+        {
+            if (!arg(o.code))
+                return 2;
+            haveCode = true;
+        }
+        else if (a == "-e" || a == "--engine")
+        {
+            if (!arg(v))
+                return 2;
+            o.engine = brainfEngineFromName(v);
+            if (o.engine == BFE_NUM)
+            {
+                std::cerr << "unknown engine '" << v << "'" << std::endl;
+                return 2;
+            }
+        }
+        else if (a == "-t" || a == "--cell")
+        {
+            if (!arg(o.cell))
+                return 2;
+        }
+        else if (a == "-s" || a == "--max-steps")
+        {
+            if (!arg(v))
+                return 2;
+            o.maxSteps = std::strtoull(v.c_str(), 0, 10);
+        }
+        else if (a == "-n" || a == "--numbers")
+            o.numbers = true;
+        else if (a == "--stop-infinite")
+            o.stopInfinite = true;
+        else if (a == "--no-wait")
+            o.waitInput = false;
+        else if (a == "--stats")
+            o.stats = true;
+        else if (a == "--analyze")
+            o.analyze = true;
+        else if (a == "--profile")
+        {
+            if (!arg(o.profileFile))
+                return 2;
+        }
+        else if (a == "--folded")
+            o.profileFolded = true;
+        else if (a == "-g" || a == "--ga")
+            o.ga = true;
+        else if (a == "--target")
+        {
+            if (!arg(o.target))
+                return 2;
+        }
+        else if (a == "--population")
+        {
+            if (!arg(v))
+                return 2;
+            o.population = std::max(1ULL, std::strtoull(v.c_str(), 0, 10));
+        }
+        else if (a == "--generations")
+        {
+            if (!arg(v))
+                return 2;
+            o.generations = std::strtoull(v.c_str(), 0, 10);
+        }
+        else if (a == "--fitness")
+        {
+            if (!arg(v))
+                return 2;
+            o.fitness = std::strtod(v.c_str(), 0);
+        }
+        else if (a == "--dump-every")
+        {
+            if (!arg(v))
+                return 2;
+            o.dumpEvery = std::strtoull(v.c_str(), 0, 10);
+        }
+        else if (a == "--dump")
+        {
+            if (!arg(v))
+                return 2;
+            o.dumpCount = std::strtoull(v.c_str(), 0, 10);
+        }
+        else if (a == "--gene-steps")
+        {
+            if (!arg(v))
+                return 2;
+            o.geneSteps = std::strtoull(v.c_str(), 0, 10);
+        }
+        else if (a == "--checkpoint")
+        {
+            if (!arg(o.checkpoint))
+                return 2;
+        }
+        else if (a == "--checkpoint-every")
+        {
+            if (!arg(v))
+                return 2;
+            o.checkpointEvery = std::strtoull(v.c_str(), 0, 10);
+        }
+        else if (a == "--processes")
+        {
+            if (!arg(v))
+                return 2;
+            o.processes = std::strtoull(v.c_str(), 0, 10);
+        }
+        else if (a == "--islands")
+        {
+            if (!arg(v))
+                return 2;
+            o.islands = std::max(1ULL, std::strtoull(v.c_str(), 0, 10));
+        }
+        else if (a.size() > 1 && a[0] == '-')
+        {
+            std::cerr << "unknown option '" << a << "'" << std::endl;
+            printUsage(std::cerr);
+            return 2;
+        }
+        else
+            file = a;
+    }
+
+    if (o.ga)
+        return -1;
+
+    if (!haveCode)
+    {
+        if (file.empty())
+        {
+            printUsage(std::cerr);
+            return 2;
+        }
+        if (!readFile(file, o.code))
+        {
+            std::cerr << "can not read '" << file << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    return -1;
+}
+
+
+/** Writes the pending output of @p bf to stdout and clears it */
+template <typename T>
+void flushOutput(Brainf<T>& bf, const Options& o, bool& first)
+{
+    if (bf.output().empty())
+        return;
+
+    if (o.numbers)
+    {
+        if (!first)
+            std::fputs(", ", stdout);
+        std::fputs(bf.outputStringNum().c_str(), stdout);
+    }
+    else
+    {
+        const std::string s = bf.outputString();
+        std::fwrite(s.data(), 1, s.size(), stdout);
+    }
+    std::fflush(stdout);
+
+    first = false;
+    bf.clearOutput();
+}
+
+template <typename T>
+int runProgram(const Options& o)
+{
+    int flags = BFF_EXPAND_RIGHT | BFF_EXPAND_LEFT;
+    if (o.stopInfinite)
+        flags |= BFF_STOP_INFINITE;
+    if (o.waitInput)
+        flags |= BFF_WAIT_INPUT;
+
+    Brainf<T> bf(16, 16, flags);
+    bf.setEngine(o.engine);
+    bf.setCode(o.code);
+
+    const auto start = std::chrono::steady_clock::now();
+    // steps per call to run(), between output flushes
+    const size_t chunk = 1 << 20;
+    size_t steps = 0;
+    bool first = true, stalled = false;
+    BrainfProfile profile;
+    const bool doProfile = !o.profileFile.empty();
+
+    while (bf.programPosition() < (typename Brainf<T>::Index)bf.code().size())
+    {
+        size_t n = chunk;
+        if (o.maxSteps)
+        {
+            if (steps >= o.maxSteps)
+                break;
+            n = std::min(n, o.maxSteps - steps);
+        }
+
+        const BrainfRunResult res = doProfile ? bf.run(n, profile) : bf.run(n);
+        steps += res.steps;
+        flushOutput(bf, o, first);
+
+        if (res.status == BFR_WAIT_INPUT)
+        {
+            char buf[4096];
+            const ssize_t r = ::read(0, buf, sizeof(buf));
+            if (r > 0)
+                bf.appendInput(std::string(buf, r));
+            else
+                // end of input, read 0 from now on
+                bf.setFlags(bf.flags() & ~BFF_WAIT_INPUT);
+        }
+        else if (res.status == BFR_INFINITE)
+        {
+            stalled = true;
+            break;
+        }
+    }
+
+    if (o.numbers && !first)
+        std::fputs("\n", stdout);
+    std::fflush(stdout);
+
+    if (doProfile)
+    {
+        std::ofstream f(o.profileFile);
+        if (!f)
+        {
+            std::cerr << "can not write '" << o.profileFile << "'" << std::endl;
+            return 1;
+        }
+        f << (o.profileFolded ? profile.foldedStacks(bf.code())
+                              : profile.annotatedListing(bf.code()));
+    }
+
+    if (o.stats)
+    {
+        const double sec = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+        std::cerr << "steps: " << steps
+                  << ", time: " << sec << "s"
+                  << ", ops/sec: " << size_t(steps / std::max(sec, 1e-9))
+                  << ", tape: " << bf.tapeEnd() - bf.tapeBegin() << " cells, "
+                  << bf.tapeMemory() << " in memory"
+                  << (bf.isTapeSparse() ? " (sparse)" : "");
+        if (stalled)
+            std::cerr << ", stopped at infinite loop at " << bf.programPosition();
+        else if (bf.programPosition() < (typename Brainf<T>::Index)bf.code().size())
+            std::cerr << ", step limit reached";
+        std::cerr << std::endl;
+    }
+
+    return 0;
+}
+
+int runGa(const Options& o)
+{
+    BrainfGene prototype;
+    prototype.setTarget(o.target);
+    prototype.setMaxSteps(o.geneSteps);
+
+    // before any other thread is started
+    std::unique_ptr<GeneProcessEvaluator> evaluator;
+    if (o.processes)
+        evaluator.reset(new GeneProcessEvaluator(prototype, o.processes));
+
+    GenePool pool;
+    pool.setEvaluator(evaluator.get());
+    GenePool::Settings set;
+    set.numIslands = o.islands;
+    pool.setSettings(set);
+
+    if (!o.checkpoint.empty() && pool.loadFile(o.checkpoint, prototype))
+        std::cerr << "resuming " << o.checkpoint
+                  << " at generation " << pool.generation() << std::endl;
+    else
+    {
+        std::vector<Gene*> genes;
+        for (size_t i=0; i<o.population; ++i)
+        {
+            auto g = new BrainfGene();
+            g->setTarget(o.target);
+            g->setMaxSteps(o.geneSteps);
+            genes.push_back(g);
+        }
+        pool.initialize(genes);
+        pool.evaluate();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const size_t first = pool.generation();
+    const uint64_t firstEval = pool.numEvaluations(),
+                   firstChildren = pool.numChildren(),
+                   firstDuplicates = pool.numDuplicates();
+    double f = pool.getBest()->fitness();
+    size_t i = first;
+    for (; f < o.fitness && (o.generations == 0 || i < o.generations); ++i)
+    {
+        pool.nextGeneration();
+        pool.evaluate();
+        f = pool.getBest()->fitness();
+
+        if (o.dumpEvery && i % o.dumpEvery == 0)
+        {
+            std::cout << "\nGENERATION " << i << std::endl;
+            pool.dump(o.dumpCount);
+        }
+        if (!o.checkpoint.empty() && o.checkpointEvery
+            && pool.generation() % o.checkpointEvery == 0)
+            pool.saveFileAsync(o.checkpoint);
+    }
+
+    std::cout << "\nGENERATION " << i << std::endl;
+    pool.dump(o.dumpCount);
+
+    if (!o.checkpoint.empty() && !pool.saveFile(o.checkpoint))
+        std::cerr << "could not write " << o.checkpoint << std::endl;
+
+    if (o.stats)
+    {
+        const double sec = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+        std::cerr << "generations: " << i - first
+                  << ", time: " << sec << "s"
+                  << ", generations/sec: " << (i - first) / std::max(sec, 1e-9)
+                  << ", evaluations/sec: " << (pool.numEvaluations() - firstEval) / std::max(sec, 1e-9)
+                  << ", duplicates: " << 100. * (pool.numDuplicates() - firstDuplicates)
+                                         / std::max(uint64_t(1), pool.numChildren() - firstChildren) << "%"
+                  << std::endl;
+    }
+
+    return 0;
+}
+
+/** Prints the BrainfAnalysis of the program */
+int analyzeProgram(const Options& o)
+{
+    const auto code = Brainf<u_int8_t>::parseCode(o.code);
+    // the tape of runProgram(), the start is run for at most 4096 steps
+    const BrainfAnalysis a(code, o.maxSteps ? std::min(o.maxSteps, size_t(4096)) : 4096,
+                           16, 16, BFF_EXPAND_RIGHT | BFF_EXPAND_LEFT);
+
+    size_t infinite = 0, affine = 0;
+    for (auto & l : a.loops())
+    {
+        infinite += l.infinite;
+        affine += l.affine;
+    }
+
+    std::cout << "opcodes: " << code.size()
+              << (a.isBalanced() ? "" : ", unbalanced brackets")
+              << "\nloops: " << a.loops().size()
+              << ", " << infinite << " infinite, " << affine << " affine\n";
+    if (!a.hasOutput())
+        std::cout << "no output\n";
+    else
+    {
+        std::cout << "last output at " << a.lastOutput();
+        if (a.outputEnd() < BrainfAnalysis::Index(code.size()))
+            std::cout << ", dead code from " << a.outputEnd() << " on";
+        std::cout << "\n";
+    }
+    if (a.stallPosition() >= 0)
+        std::cout << "stalls without output at " << a.stallPosition() << "\n";
+    return 0;
+}
+
+typedef int (*RunFunc)(const Options&);
+
+struct CellType
+{
+    const char * name;
+    RunFunc func;
+};
+
+const CellType cellTypes[] =
+{
+    { "uint8",      runProgram<u_int8_t> },
+    { "int8",       runProgram<int8_t> },
+    { "uint16",     runProgram<u_int16_t> },
+    { "int16",      runProgram<int16_t> },
+    { "uint32",     runProgram<u_int32_t> },
+    { "int32",      runProgram<int32_t> },
+    { "uint64",     runProgram<u_int64_t> },
+    { "int64",      runProgram<int64_t> },
+    { "uint8_sat",  runProgram<Brainf_saturated<u_int8_t>> },
+    { "int8_sat",   runProgram<Brainf_saturated<int8_t>> },
+    { "uint16_sat", runProgram<Brainf_saturated<u_int16_t>> },
+    { "int16_sat",  runProgram<Brainf_saturated<int16_t>> },
+    { "uint32_sat", runProgram<Brainf_saturated<u_int32_t>> },
+    { "int32_sat",  runProgram<Brainf_saturated<int32_t>> },
+    { "uint64_sat", runProgram<Brainf_saturated<u_int64_t>> },
+    { "int64_sat",  runProgram<Brainf_saturated<int64_t>> },
+    { "big",        runProgram<Brainf_bignum> }
+};
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+    Options o;
+    const int r = parseArgs(argc, argv, o);
+    if (r >= 0)
+        return r;
+
+    if (o.ga)
+        return runGa(o);
+    if (o.analyze)
+        return analyzeProgram(o);
+
+    for (auto & c : cellTypes)
+        if (o.cell == c.name)
+            return c.func(o);
+
+    std::cerr << "unknown cell type '" << o.cell << "'" << std::endl;
+    return 2;
+}
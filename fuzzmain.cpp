@@ -0,0 +1,447 @@
+/** @file fuzzmain.cpp
+
+    @brief Differential fuzzing of the interpreter engines
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+/*  Each test case is a string of bytes that is decoded into flags, tape
+    size, step limit, input and a program, which is built like
+    BrainfGene::addOpcode_() does. The program runs with the reference
+    engine, and all engines must end in the same state when run at once,
+    in small chunks, with a snapshot() and restore() in between, with
+    profiling and with the paged (sparse) tape.
+
+    Built with BRAINF_LIBFUZZER defined (and -fsanitize=fuzzer) this is a
+    libFuzzer target, otherwise a standalone program that feeds random
+    bytes or the given case files.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <iterator>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "brainf.h"
+
+/** Maximum number of steps of a test case */
+#define FUZZ_MAX_STEPS 4096
+/** Maximum number of opcodes of a test case */
+#define FUZZ_MAX_LENGTH 200
+
+namespace {
+
+/** Reads the bytes of a test case, 0 when exhausted */
+class ByteReader
+{
+public:
+    ByteReader(const uint8_t * data, size_t size) : p_(data), e_(data + size) { }
+    bool atEnd() const { return p_ >= e_; }
+    uint8_t byte() { return p_ < e_ ? *p_++ : 0; }
+private:
+    const uint8_t * p_, * e_;
+};
+
+/** A decoded test case */
+struct Case
+{
+    int flags, cell;
+    std::ptrdiff_t tapeLength, tapeLengthNeg;
+    size_t maxSteps, chunk;
+    std::string input;
+    std::vector<BrainfOpcode> code;
+};
+
+/** Number of cell types of Case::cell */
+#define FUZZ_NUM_CELLS 8
+
+const char * cellName(int cell)
+{
+    static const char * names[FUZZ_NUM_CELLS] =
+        { "uint8", "int8", "uint16", "int32", "uint64", "uint8_sat", "int16_sat", "big" };
+    return names[cell];
+}
+
+Case decode(const uint8_t * data, size_t size)
+{
+    ByteReader r(data, size);
+    Case c;
+    c.flags = r.byte() & (BFF_EXPAND_LEFT | BFF_EXPAND_RIGHT
+                          | BFF_STOP_INFINITE | BFF_WAIT_INPUT);
+    c.cell = r.byte() % FUZZ_NUM_CELLS;
+    c.tapeLength = 1 + r.byte() % 32;
+    c.tapeLengthNeg = r.byte() % 32;
+    c.maxSteps = r.byte();
+    c.maxSteps = 1 + (c.maxSteps | (size_t(r.byte()) << 8)) % FUZZ_MAX_STEPS;
+    c.chunk = 1 + r.byte() % 64;
+    for (int i = r.byte() % 16; i > 0; --i)
+        c.input += char(r.byte());
+
+    // inserts at random positions, like BrainfGene::addOpcode_()
+    while (!r.atEnd() && c.code.size() < FUZZ_MAX_LENGTH)
+    {
+        const size_t pos = r.byte() % (c.code.size() + 1);
+        const uint8_t b = r.byte();
+        const BrainfOpcode op = BrainfOpcode(BFO_LEFT + b % 8);
+        // a single bracket, like after BrainfGene::cross()
+        if ((op == BFO_BEGIN || op == BFO_END) && !(b & 0x80))
+        {
+            const BrainfOpcode loop[3] =
+                { BFO_BEGIN, BrainfOpcode(BFO_LEFT + (b >> 3) % 5), BFO_END };
+            c.code.insert(c.code.begin() + pos, loop, loop + 3);
+        }
+        else
+            c.code.insert(c.code.begin() + pos, op);
+    }
+    return c;
+}
+
+std::string describe(const Case& c)
+{
+    std::stringstream s;
+    s << "cell " << cellName(c.cell) << ", flags " << c.flags
+      << ", tape " << c.tapeLengthNeg << "+" << c.tapeLength
+      << ", max steps " << c.maxSteps << ", chunk " << c.chunk
+      << "\ninput:";
+    for (char ch : c.input)
+        s << " " << int(uint8_t(ch));
+    Brainf<uint8_t> bf;
+    bf.setCode(c.code);
+    s << "\ncode:  " << bf.codeString();
+    return s.str();
+}
+
+/** The observable state after a run */
+template <typename T>
+struct State
+{
+    BrainfRunStatus status;
+    size_t steps;
+    std::ptrdiff_t pc, tp, ip;
+    bool waiting;
+    std::vector<T> output;
+    /** Tape positions of tape[0] */
+    std::ptrdiff_t tapeBegin;
+    std::vector<T> tape;
+
+    State(const Brainf<T>& bf, const BrainfRunResult& r)
+        : status    (r.status)
+        , steps     (r.steps)
+        , pc        (bf.programPosition())
+        , tp        (bf.tapePosition())
+        , ip        (bf.inputPosition())
+        , waiting   (bf.isWaitingForInput())
+        , output    (bf.output())
+        , tapeBegin (-bf.tapeOffset())
+        , tape      (bf.tape())
+    { }
+
+    /** Cell at tape position @p pos, cells not in the tape are 0 */
+    T cell(std::ptrdiff_t pos) const
+    {
+        pos -= tapeBegin;
+        return pos >= 0 && pos < std::ptrdiff_t(tape.size()) ? tape[pos] : T(0);
+    }
+
+    /** Compares everything, tapes of different extent are
+        compared on the positions that either one has */
+    bool operator == (const State& o) const
+    {
+        if (status != o.status || steps != o.steps || pc != o.pc || tp != o.tp || ip != o.ip
+            || waiting != o.waiting || output != o.output)
+            return false;
+        const std::ptrdiff_t
+                b = std::min(tapeBegin, o.tapeBegin),
+                e = std::max(tapeBegin + std::ptrdiff_t(tape.size()),
+                             o.tapeBegin + std::ptrdiff_t(o.tape.size()));
+        for (std::ptrdiff_t i = b; i < e; ++i)
+            if (cell(i) != o.cell(i))
+                return false;
+        return true;
+    }
+
+    std::string toString() const
+    {
+        std::stringstream s;
+        s << brainfRunStatusName(status) << ", steps " << steps << ", pc " << pc << ", tape pos " << tp
+          << ", input pos " << ip << (waiting ? ", waiting" : "")
+          << "\n  output: " << Brainf<T>::toStringNum(output);
+        // the cells around the tape position
+        std::vector<T> cells;
+        for (std::ptrdiff_t i = tp - 16; i < tp + 16; ++i)
+            cells.push_back(cell(i));
+        s << "\n  tape from " << tp - 16 << ": " << Brainf<T>::toStringNum(cells);
+        return s.str();
+    }
+};
+
+struct Stats
+{
+    Stats() : cases(0), runs(0), steps(0) { }
+    size_t cases, runs, steps;
+};
+
+/** Runs the case in chunks, with a snapshot() and restore()
+    after the first one if @p restore is true.
+    Returns the status of the last chunk and the steps of all. */
+template <typename T>
+BrainfRunResult runChunked(Brainf<T>& bf, const Case& c, bool restore)
+{
+    size_t steps = 0;
+    BrainfRunResult r;
+    while (steps < c.maxSteps)
+    {
+        const size_t n = std::min(c.chunk, c.maxSteps - steps);
+        r = bf.run(n);
+        steps += r.steps;
+        if (r.status != BFR_STEP_LIMIT)
+            break;
+        if (restore)
+        {
+            // return to here after running on with scratched output
+            restore = false;
+            const typename Brainf<T>::Snapshot s = bf.snapshot();
+            bf.run(c.chunk);
+            bf.restore(s);
+        }
+    }
+    r.steps = steps;
+    return r;
+}
+
+template <typename T>
+bool checkCase(const Case& c, Stats& stats)
+{
+    static Brainf<T> bf;
+    auto prepare = [&](BrainfEngine e, bool sparse)
+    {
+        // sparse from the start, or switching while running
+        bf.setMaxDenseTape(!sparse ? Brainf<T>::DEFAULT_MAX_DENSE_TAPE
+                                   : c.chunk % 2 ? 0 : 64);
+        bf.clear(c.tapeLength, c.tapeLengthNeg);
+        bf.setFlags(c.flags);
+        bf.setEngine(e);
+        bf.setCode(c.code);
+        bf.setInput(c.input);
+    };
+
+    prepare(BFE_REFERENCE, false);
+    const BrainfRunResult refResult = bf.run(c.maxSteps);
+    const State<T> ref(bf, refResult);
+    stats.steps += refResult.steps;
+    ++stats.runs;
+
+    for (int e = 0; e < BFE_NUM; ++e)
+    for (int mode = 0; mode < 5; ++mode)
+    {
+        if (e == BFE_REFERENCE && mode == 0)
+            continue;
+
+        prepare(BrainfEngine(e), mode == 4);
+        BrainfRunResult r;
+        switch (mode)
+        {
+            default: r = bf.run(c.maxSteps); break;
+            case 1: r = runChunked(bf, c, false); break;
+            case 2: r = runChunked(bf, c, true); break;
+            case 3: { BrainfProfile p; r = bf.run(c.maxSteps, p); } break;
+            case 4: r = runChunked(bf, c, true); break;
+        }
+        ++stats.runs;
+
+        const State<T> s(bf, r);
+        if (!(s == ref))
+        {
+            static const char * modes[] = { "run", "chunked", "restored", "profiled", "sparse" };
+            std::cerr << "MISMATCH engine " << brainfEngineName(BrainfEngine(e))
+                      << " (" << modes[mode] << ")\n" << describe(c)
+                      << "\nreference: " << ref.toString()
+                      << "\nengine:    " << s.toString() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Checks one test case, returns false on a mismatch */
+bool fuzzOne(const uint8_t * data, size_t size, Stats& stats)
+{
+    const Case c = decode(data, size);
+    ++stats.cases;
+    switch (c.cell)
+    {
+        case 0: return checkCase<u_int8_t>(c, stats);
+        case 1: return checkCase<int8_t>(c, stats);
+        case 2: return checkCase<u_int16_t>(c, stats);
+        case 3: return checkCase<int32_t>(c, stats);
+        case 4: return checkCase<u_int64_t>(c, stats);
+        case 5: return checkCase<Brainf_saturated<u_int8_t>>(c, stats);
+        case 6: return checkCase<Brainf_saturated<int16_t>>(c, stats);
+        default: return checkCase<Brainf_bignum>(c, stats);
+    }
+}
+
+} // namespace
+
+
+
+#ifdef BRAINF_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+    static Stats stats;
+    if (!fuzzOne(data, size, stats))
+        std::abort();
+    return 0;
+}
+
+#else
+
+namespace {
+
+double now()
+{
+    return std::chrono::duration<double>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void printUsage(std::ostream& out)
+{
+    out <<
+    "usage: brainf-fuzz [options] [case ...]\n"
+    "\n"
+    "Runs random programs with all engines and compares the results.\n"
+    "Given case files (e.g. from --out or libFuzzer) are checked instead.\n"
+    "\n"
+    "  -n, --cases N         stop after N cases (default 0 = unlimited)\n"
+    "  -t, --time SEC        stop after SEC seconds (default 60)\n"
+    "  -s, --seed N          random seed (default 1)\n"
+    "      --report SEC      print throughput every SEC seconds (default 10)\n"
+    "  -o, --out FILE        write a failing case to FILE (default fuzz-failure.bin)\n"
+    "  -h, --help            show this help\n";
+}
+
+void printStats(const Stats& stats, double sec)
+{
+    sec = std::max(sec, 1e-9);
+    std::cerr << stats.cases << " cases, " << stats.runs << " runs in "
+              << std::fixed << std::setprecision(1) << sec << "s, "
+              << std::setprecision(0) << stats.cases * 60. / sec << " cases/min, "
+              << stats.steps / sec << " reference steps/sec" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t maxCases = 0, seed = 1;
+    double maxTime = 60., report = 10.;
+    std::string outFile = "fuzz-failure.bin";
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+        const bool hasArg = i + 1 < argc;
+
+        if (a == "-h" || a == "--help")
+        {
+            printUsage(std::cout);
+            return 0;
+        }
+        else if ((a == "-n" || a == "--cases") && hasArg)
+            maxCases = std::strtoull(argv[++i], 0, 10);
+        else if ((a == "-t" || a == "--time") && hasArg)
+            maxTime = std::strtod(argv[++i], 0);
+        else if ((a == "-s" || a == "--seed") && hasArg)
+            seed = std::strtoull(argv[++i], 0, 10);
+        else if (a == "--report" && hasArg)
+            report = std::strtod(argv[++i], 0);
+        else if ((a == "-o" || a == "--out") && hasArg)
+            outFile = argv[++i];
+        else if (a.size() > 1 && a[0] == '-')
+        {
+            std::cerr << "unknown option or missing argument '" << a << "'" << std::endl;
+            printUsage(std::cerr);
+            return 2;
+        }
+        else
+            files.push_back(a);
+    }
+
+    Stats stats;
+
+    // replay case files
+    if (!files.empty())
+    {
+        int failed = 0;
+        for (auto & fn : files)
+        {
+            std::ifstream f(fn, std::ios::binary);
+            if (!f)
+            {
+                std::cerr << "can not read '" << fn << "'" << std::endl;
+                return 1;
+            }
+            const std::string data((std::istreambuf_iterator<char>(f)),
+                                   std::istreambuf_iterator<char>());
+            if (!fuzzOne(reinterpret_cast<const uint8_t*>(data.data()), data.size(), stats))
+            {
+                std::cerr << "in '" << fn << "'" << std::endl;
+                ++failed;
+            }
+        }
+        return failed ? 1 : 0;
+    }
+
+    std::mt19937 rnd(seed);
+    std::vector<uint8_t> data;
+    const double start = now();
+    double lastReport = start, t = start;
+
+    while (maxCases == 0 || stats.cases < maxCases)
+    {
+        // header and a program of random length
+        data.resize(8 + 16 + 2 * (rnd() % FUZZ_MAX_LENGTH));
+        for (auto & b : data)
+            b = uint8_t(rnd());
+
+        if (!fuzzOne(&data[0], data.size(), stats))
+        {
+            std::ofstream f(outFile, std::ios::binary);
+            f.write(reinterpret_cast<const char*>(&data[0]), data.size());
+            std::cerr << "case written to '" << outFile << "'" << std::endl;
+            printStats(stats, now() - start);
+            return 1;
+        }
+
+        // look at the clock only now and then
+        if ((stats.cases & 255) == 0)
+        {
+            t = now();
+            if (maxTime > 0. && t - start >= maxTime)
+                break;
+            if (report > 0. && t - lastReport >= report)
+            {
+                printStats(stats, t - start);
+                lastReport = t;
+            }
+        }
+    }
+
+    printStats(stats, now() - start);
+    return 0;
+}
+
+#endif // BRAINF_LIBFUZZER
@@ -13,6 +13,9 @@
 Gene::Gene()
     : p_pool_     (0)
     , p_gen_      (0)
+    , p_fit_      (0.)
+    , p_pfit_     (0.)
+    , p_eval_     (false)
 {
 
 }
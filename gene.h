@@ -12,6 +12,8 @@
 #define GENE_H
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <string>
 
 class GenePool;
@@ -26,6 +28,8 @@ public:
 
     size_t generation() const { return p_gen_; }
     double fitness() const { return p_fit_; }
+    /** Returns true when fitness() is up to date with the gene */
+    bool isEvaluated() const { return p_eval_; }
 
     GenePool * pool() const { return p_pool_; }
 
@@ -39,17 +43,62 @@ public:
     virtual void initialize() = 0;
     virtual bool operator == (const Gene * other) const = 0;
 
+    /** Hash of the genotype, equal genes must return equal hashes.
+        Called often, so it should be cached by the gene. */
+    virtual uint64_t hash() const = 0;
+
     virtual void mutate(double amt, double prob) = 0;
     virtual void cross(const Gene * other) = 0;
 
     virtual double evaluate() = 0;
 
+    /** Appends the gene specific state in binary form to @p data */
+    virtual void serialize(std::string& data) const = 0;
+
+    /** Restores the state written by serialize() from the bytes
+        starting at @p data and moves @p data behind them.
+        Returns false if the data is invalid or exceeds @p end. */
+    virtual bool deserialize(const char *& data, const char * end) = 0;
+
+protected:
+
+    // --- helper for serialize() in host byte order ---
+
+    template <typename V>
+    static void writeValue_(std::string& data, const V& v)
+        { data.append(reinterpret_cast<const char*>(&v), sizeof(V)); }
+
+    template <typename V>
+    static bool readValue_(const char *& data, const char * end, V& v)
+    {
+        if (end - data < (std::ptrdiff_t)sizeof(V))
+            return false;
+        std::memcpy(&v, data, sizeof(V));
+        data += sizeof(V);
+        return true;
+    }
+
+    static void writeString_(std::string& data, const std::string& s)
+        { writeValue_(data, uint32_t(s.size())); data += s; }
+
+    static bool readString_(const char *& data, const char * end, std::string& s)
+    {
+        uint32_t size;
+        if (!readValue_(data, end, size) || end - data < (std::ptrdiff_t)size)
+            return false;
+        s.assign(data, size);
+        data += size;
+        return true;
+    }
 
 private:
 
     GenePool * p_pool_;
     size_t p_gen_;
-    double p_fit_;
+    double p_fit_,
+    /** Fitness of the parent, for adaptive mutation */
+           p_pfit_;
+    bool p_eval_;
 
 };
 
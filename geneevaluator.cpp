@@ -0,0 +1,282 @@
+/** @file geneevaluator.cpp
+
+    @brief Evaluation of genes outside of GenePool
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#include <deque>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <algorithm>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "geneevaluator.h"
+#include "gene.h"
+
+/** Number of batches sent to a worker before its first reply */
+#define PIPELINE_DEPTH 2
+
+namespace {
+
+    bool readAll(int fd, void * data, size_t size)
+    {
+        char * p = static_cast<char*>(data);
+        while (size)
+        {
+            const ssize_t n = ::read(fd, p, size);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    bool writeAll(int fd, const void * data, size_t size)
+    {
+        const char * p = static_cast<const char*>(data);
+        while (size)
+        {
+            // a dead worker gives EPIPE instead of SIGPIPE
+            const ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    template <typename V>
+    void append(std::string& data, const V& v)
+        { data.append(reinterpret_cast<const char*>(&v), sizeof(V)); }
+
+} // namespace
+
+
+GeneProcessEvaluator::GeneProcessEvaluator(
+        const Gene& prototype, size_t numWorkers, size_t batchSize)
+    : p_proto_      (prototype.clone())
+    , p_workers_    (std::max(size_t(1), numWorkers))
+    , p_batch_      (std::max(size_t(1), batchSize))
+    , p_restarts_   (0)
+{
+    for (auto& w : p_workers_)
+    {
+        w.pid = -1;
+        w.fd = -1;
+    }
+    for (auto& w : p_workers_)
+        start_(w);
+}
+
+GeneProcessEvaluator::~GeneProcessEvaluator()
+{
+    for (auto& w : p_workers_)
+        stop_(w);
+}
+
+void GeneProcessEvaluator::start_(Worker& w)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return;
+
+    const pid_t pid = ::fork();
+    if (pid < 0)
+    {
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return;
+    }
+
+    if (pid == 0)
+    {
+        // the other workers must see the end of their socket
+        // when the coordinator closes it
+        for (auto& o : p_workers_)
+            if (o.fd >= 0)
+                ::close(o.fd);
+        ::close(fds[0]);
+        work_(fds[1]);
+        ::_exit(0);
+    }
+
+    ::close(fds[1]);
+    w.pid = pid;
+    w.fd = fds[0];
+}
+
+void GeneProcessEvaluator::stop_(Worker& w)
+{
+    if (w.fd >= 0)
+        ::close(w.fd);
+    if (w.pid > 0)
+        ::waitpid(w.pid, 0, 0);
+    w.fd = -1;
+    w.pid = -1;
+}
+
+void GeneProcessEvaluator::work_(int fd)
+{
+    std::unique_ptr<Gene> gene(p_proto_->clone());
+    std::string data, reply;
+    for (;;)
+    {
+        // [num] ([size] [bytes])*
+        uint32_t num, size;
+        if (!readAll(fd, &num, sizeof(num)))
+            return;
+        reply.clear();
+        append(reply, num);
+        for (uint32_t i=0; i<num; ++i)
+        {
+            if (!readAll(fd, &size, sizeof(size)))
+                return;
+            data.resize(size);
+            if (size && !readAll(fd, &data[0], size))
+                return;
+
+            const char * p = data.data();
+            double fit = 0.;
+            if (gene->deserialize(p, p + size))
+                fit = gene->evaluate();
+            append(reply, fit);
+        }
+        // [num] [fitness]*
+        if (!writeAll(fd, reply.data(), reply.size()))
+            return;
+    }
+}
+
+void GeneProcessEvaluator::evaluate(
+        const std::vector<Gene*>& genes, std::vector<double>& fitness)
+{
+    fitness.assign(genes.size(), 0.);
+
+    std::deque<Batch> todo;
+    for (size_t i = 0; i < genes.size(); i += p_batch_)
+    {
+        Batch b;
+        b.crashes = 0;
+        for (size_t j = i; j < std::min(genes.size(), i + p_batch_); ++j)
+            b.genes.push_back(j);
+        todo.push_back(b);
+    }
+
+    std::vector<std::deque<Batch>> sent(p_workers_.size());
+    std::vector<pollfd> polls;
+    std::vector<size_t> polled;
+    std::string data, gene;
+    std::vector<double> reply;
+
+    // requeues the batches of a dead worker and restarts it
+    auto restart = [&](size_t k)
+    {
+        auto& s = sent[k];
+        if (!s.empty())
+        {
+            // only the first batch was being evaluated
+            Batch& b = s.front();
+            if (++b.crashes >= 2)
+            {
+                if (b.genes.size() == 1)
+                    fitness[b.genes[0]] = 0.;
+                else
+                    for (auto i : b.genes)
+                    {
+                        Batch single;
+                        single.genes.push_back(i);
+                        single.crashes = 0;
+                        todo.push_back(single);
+                    }
+                s.pop_front();
+            }
+            todo.insert(todo.begin(), s.begin(), s.end());
+            s.clear();
+        }
+        stop_(p_workers_[k]);
+        start_(p_workers_[k]);
+        ++p_restarts_;
+    };
+
+    for (;;)
+    {
+        // keep every worker busy
+        for (size_t k = 0; k < p_workers_.size(); ++k)
+        while (!todo.empty() && sent[k].size() < PIPELINE_DEPTH
+               && p_workers_[k].fd >= 0)
+        {
+            Batch b = todo.front();
+            todo.pop_front();
+
+            data.clear();
+            append(data, uint32_t(b.genes.size()));
+            for (auto i : b.genes)
+            {
+                gene.clear();
+                genes[i]->serialize(gene);
+                append(data, uint32_t(gene.size()));
+                data += gene;
+            }
+            sent[k].push_back(b);
+            if (!writeAll(p_workers_[k].fd, data.data(), data.size()))
+                restart(k);
+        }
+
+        polls.clear();
+        polled.clear();
+        for (size_t k = 0; k < p_workers_.size(); ++k)
+        if (!sent[k].empty())
+        {
+            pollfd p;
+            p.fd = p_workers_[k].fd;
+            p.events = POLLIN;
+            p.revents = 0;
+            polls.push_back(p);
+            polled.push_back(k);
+        }
+        if (polls.empty())
+            break;
+
+        if (::poll(&polls[0], polls.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (size_t j = 0; j < polls.size(); ++j)
+        if (polls[j].revents)
+        {
+            const size_t k = polled[j];
+            const Batch& b = sent[k].front();
+            uint32_t num;
+            reply.resize(b.genes.size());
+            if (!readAll(p_workers_[k].fd, &num, sizeof(num))
+                || num != b.genes.size()
+                || !readAll(p_workers_[k].fd, &reply[0], num * sizeof(double)))
+            {
+                restart(k);
+                continue;
+            }
+            for (size_t i = 0; i < num; ++i)
+                fitness[b.genes[i]] = reply[i];
+            sent[k].pop_front();
+        }
+    }
+}
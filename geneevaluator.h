@@ -0,0 +1,95 @@
+/** @file geneevaluator.h
+
+    @brief Evaluation of genes outside of GenePool
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#ifndef GENEEVALUATOR_H
+#define GENEEVALUATOR_H
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+
+#include <sys/types.h>
+
+class Gene;
+
+/** Interface for GenePool::setEvaluator() */
+class GeneEvaluator
+{
+public:
+    virtual ~GeneEvaluator() { }
+
+    /** Stores the fitness of each of @p genes in @p fitness,
+        which has the same size. */
+    virtual void evaluate(const std::vector<Gene*>& genes,
+                          std::vector<double>& fitness) = 0;
+};
+
+
+/** Evaluates genes in local worker processes.
+
+    The genes are serialized in batches and sent through a Unix
+    domain socket to each worker, which deserializes them into a
+    clone of the prototype, calls Gene::evaluate() and returns
+    the fitness values. Each worker has a few batches in flight,
+    so it never waits for the coordinator.
+
+    A worker that dies is restarted and its batches are sent again.
+    A batch that kills a worker twice is split into single genes,
+    and a single gene that does is given a fitness of 0.
+
+    The workers are forked from the calling process, so the
+    evaluator should be created before other threads are started.
+*/
+class GeneProcessEvaluator : public GeneEvaluator
+{
+public:
+
+    /** Starts @p numWorkers processes that evaluate
+        clones of @p prototype, in batches of @p batchSize */
+    GeneProcessEvaluator(const Gene& prototype, size_t numWorkers,
+                         size_t batchSize = 64);
+    /** Stops all workers */
+    ~GeneProcessEvaluator();
+
+    size_t numWorkers() const { return p_workers_.size(); }
+    /** Number of workers that died and were restarted */
+    size_t numRestarts() const { return p_restarts_; }
+
+    void evaluate(const std::vector<Gene*>& genes,
+                  std::vector<double>& fitness) override;
+
+private:
+
+    struct Worker
+    {
+        pid_t pid;
+        /** Socket to the worker, -1 when not running */
+        int fd;
+    };
+
+    struct Batch
+    {
+        /** Indices into the genes of evaluate() */
+        std::vector<size_t> genes;
+        /** Number of times a worker died on it */
+        size_t crashes;
+    };
+
+    void start_(Worker& w);
+    void stop_(Worker& w);
+    /** The main loop of a worker process */
+    void work_(int fd);
+
+    std::unique_ptr<Gene> p_proto_;
+    std::vector<Worker> p_workers_;
+    size_t p_batch_, p_restarts_;
+};
+
+#endif // GENEEVALUATOR_H
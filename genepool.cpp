@@ -15,25 +15,203 @@
 #include <algorithm>
 #include <iomanip>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <unordered_set>
+#include <sstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "genepool.h"
 #include "gene.h"
+#include "geneevaluator.h"
+
+/** Checkpoint file identifier */
+#define CHECKPOINT_MAGIC "BFGP"
+/** Version of the checkpoint format, a byte-swapped file does not match */
+#define CHECKPOINT_VERSION uint32_t(1)
+/** Success rate of the 1/5 rule, success is a child not worse than its parent */
+#define ADAPT_SUCCESS .2
+/** Change of the mutation scale per generation */
+#define ADAPT_FACTOR 1.1
+/** Number of separately locked parts of the duplicate set */
+#define NUM_HASH_SHARDS 64
+/** Number of best genes that evaluate() ranks for the queries */
+#define NUM_RANKED 32
+
+namespace {
+
+    /** Random generator of a thread creating offspring, see nextGeneration() */
+    thread_local std::mt19937_64 * threadRng = 0;
+
+    /** The cpus of each NUMA node, empty if unknown */
+    const std::vector<cpu_set_t>& numaNodes()
+    {
+        static const std::vector<cpu_set_t> nodes = []()
+        {
+            std::vector<cpu_set_t> nodes;
+            for (int n = 0; ; ++n)
+            {
+                char fn[64];
+                std::snprintf(fn, sizeof(fn), "/sys/devices/system/node/node%d/cpulist", n);
+                FILE * f = std::fopen(fn, "r");
+                if (!f)
+                    break;
+                // e.g. "0-3,8-11"
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                int a, b;
+                while (std::fscanf(f, "%d", &a) == 1)
+                {
+                    b = a;
+                    if (std::fscanf(f, "-%d", &b) != 1)
+                        b = a;
+                    for (int c = a; c <= b && c < CPU_SETSIZE; ++c)
+                        CPU_SET(c, &cpus);
+                    if (std::fgetc(f) != ',')
+                        break;
+                }
+                std::fclose(f);
+                nodes.push_back(cpus);
+            }
+            return nodes;
+        }();
+        return nodes;
+    }
+
+} // namespace
 
 struct GenePool::Private
 {
     Private(GenePool * pool)
         : parent        (pool)
         , mt            (std::chrono::system_clock::now().time_since_epoch().count())
+        , numThreads    (1)
+        , evaluator     (0)
+        , cache         (false)
+        , numEval       (0)
+        , numCacheHits  (0)
+        , generation    (0)
+        , writing       (false)
+        , mutationScale (1.)
+        , numOffspring  (0)
+        , numImproved   (0)
+        , numChildren   (0)
+        , numDuplicates (0)
+    {
+    }
+
+    std::mt19937_64& rng() { return threadRng ? *threadRng : mt; }
+
+    /** A range of genes that is bred separately */
+    struct Island
+    {
+        Island() : begin(0), end(0), numRanked(0) { }
+        size_t size() const { return end - begin; }
+        size_t begin, end;
+        /** Indices into genes, the first numRanked are ordered by fitness */
+        std::vector<uint32_t> rank;
+        size_t numRanked;
+    };
+
+    /** Splits genes into Settings::numIslands islands */
+    void updateIslands();
+
+    /** Runs @p work for each island in its own thread,
+        pinned to the cpus of the island's NUMA node */
+    void runIslands(const std::function<void(size_t island)>& work);
+
+    /** Creates the next generation of @p is in @p next, @p migrants
+        replace the worst genes. With @p threaded, the children are
+        created in numThreads threads. */
+    void breed(Island& is, const std::vector<std::shared_ptr<Gene>>& migrants,
+               std::vector<std::shared_ptr<Gene>>& next, bool threaded);
+
+    /** Returns the rank (with ranked selection) or gene index of a parent */
+    size_t selectParent(Island& is, size_t num_rep);
+
+    /** Creates a mutated or crossed copy of a selected parent */
+    Gene * createChild(Island& is, size_t num_rep);
+
+    /** Adds to the hashes of the next generation, thread-safe.
+        Returns false if @p hash is already contained. */
+    bool insertHash(uint64_t hash);
+    void clearHashes();
+
+    ~Private()
     {
+        if (writer.joinable())
+            writer.join();
+    }
+
+    /** Writes @p data to @p filename via a temporary file */
+    static bool writeFile(const std::string& filename, const std::string& data);
+
+    /** Same order as a stable sort of gene indices by fitness */
+    bool better(uint32_t l, uint32_t r) const
+    {
+        const double fl = genes[l]->fitness(), fr = genes[r]->fitness();
+        return fl > fr || (fl == fr && l < r);
+    }
+    /** Makes sure that the first @p count entries of rank are
+        the best genes of the island in order. Only sorts what was
+        not sorted before, so repeated queries cost nothing. */
+    void rankTop(Island& is, size_t count);
+    /** Returns the indices of the best @p count genes in order,
+        from the ranking of evaluate() when it is long enough.
+        Does not change anything, so the const queries can use it. */
+    std::vector<uint32_t> best(size_t count) const;
+    /** Must be called when genes or their fitness change */
+    void invalidateRank()
+    {
+        whole.numRanked = 0;
+        for (auto& is : islands)
+            is.numRanked = 0;
     }
 
     GenePool * parent;
     std::vector<std::shared_ptr<Gene>> genes;
     std::mt19937_64 mt;
+    size_t numThreads;
+    GeneEvaluator * evaluator;
+    bool cache;
+    uint64_t numEval, numCacheHits, generation;
+
+    std::thread writer;
+    std::atomic<bool> writing;
+
+    /** All genes, for the ranking and one island */
+    Island whole;
+    std::vector<Island> islands;
+
+    Settings set;
+    double mutationScale;
+    /** Evaluated children and how many were better than their parent */
+    uint64_t numOffspring, numImproved;
+
+    /** Gene::hash() of the next generation, locked per shard */
+    struct HashShard
+    {
+        std::mutex mutex;
+        std::unordered_set<uint64_t> set;
+    };
+    HashShard hashes[NUM_HASH_SHARDS];
+    std::atomic<uint64_t> numChildren, numDuplicates;
 };
 
 
 
+
 GenePool::GenePool()
     : p_    (new Private(this))
 {
@@ -50,15 +228,12 @@ void GenePool::dump(size_t count, std::ostream &out) const
     out << std::setw(5) << "gen."
         << " " << std::setw(16) << "eval"
         << " gene\n";
-    auto list = getBest(p_->genes.size());
-    size_t k=0;
-    for (auto g : list)
+    for (auto i : p_->best(count ? count : p_->genes.size()))
     {
+        const Gene * g = p_->genes[i].get();
         out << std::setw(5) << g->generation()
             << " " << std::setw(16) << g->fitness()
             << " " << g->toString() << std::endl;
-        if (count > 0 && ++k >= count)
-            break;
     }
 }
 
@@ -67,10 +242,13 @@ void GenePool::dump(size_t count, std::ostream &out) const
 void GenePool::initialize(const std::vector<Gene*>& genes)
 {
     p_->genes.clear();
+    p_->invalidateRank();
+    p_->generation = 0;
     for (Gene * g : genes)
     {
         g->p_pool_ = this;
         g->p_gen_ = 0;
+        g->p_eval_ = false;
         g->initialize();
         // add to pool
         p_->genes.push_back(std::unique_ptr<Gene>(g));
@@ -79,95 +257,612 @@ void GenePool::initialize(const std::vector<Gene*>& genes)
 
 void GenePool::evaluate()
 {
-    for (auto & g : p_->genes)
-        g->p_fit_ = g->evaluate();
+    p_->updateIslands();
+    const auto& islands = p_->islands;
+
+    std::vector<Gene*> todo;
+    todo.reserve(p_->genes.size());
+    // start of each island in todo
+    std::vector<size_t> first;
+    for (auto & is : islands)
+    {
+        first.push_back(todo.size());
+        for (size_t i = is.begin; i < is.end; ++i)
+        {
+            Gene * g = p_->genes[i].get();
+            if (p_->cache && g->p_eval_)
+                ++p_->numCacheHits;
+            else
+                todo.push_back(g);
+        }
+    }
+    first.push_back(todo.size());
+    p_->numEval += todo.size();
+    p_->invalidateRank();
+
+    if (p_->evaluator)
+    {
+        std::vector<double> fit(todo.size());
+        if (!todo.empty())
+            p_->evaluator->evaluate(todo, fit);
+        for (size_t i = 0; i < todo.size(); ++i)
+        {
+            todo[i]->p_fit_ = fit[i];
+            todo[i]->p_eval_ = true;
+        }
+    }
+    else if (islands.size() > 1)
+    {
+        // each island evaluates its genes on its own node
+        p_->runIslands([&](size_t i)
+        {
+            for (size_t j = first[i]; j < first[i + 1]; ++j)
+            {
+                todo[j]->p_fit_ = todo[j]->evaluate();
+                todo[j]->p_eval_ = true;
+            }
+        });
+    }
+    else
+    {
+        // threads take the next gene from a shared counter
+        std::atomic<size_t> next(0);
+        auto work = [&]()
+        {
+            for (size_t i; (i = next++) < todo.size(); )
+            {
+                todo[i]->p_fit_ = todo[i]->evaluate();
+                todo[i]->p_eval_ = true;
+            }
+        };
+
+        const size_t num = std::min(p_->numThreads, todo.size());
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < num; ++i)
+            threads.push_back(std::thread(work));
+        work();
+        for (auto & t : threads)
+            t.join();
+    }
+
+    for (auto g : todo)
+    if (g->p_gen_ > 0)
+    {
+        ++p_->numOffspring;
+        p_->numImproved += g->p_fit_ >= g->p_pfit_;
+    }
+
+    // the queries only read the ranking,
+    // nextGeneration() continues it for a single island
+    p_->rankTop(p_->whole, NUM_RANKED);
 }
 
+void GenePool::setSettings(const Settings& s) { p_->set = s; }
+const GenePool::Settings& GenePool::settings() const { return p_->set; }
+double GenePool::mutationScale() const { return p_->mutationScale; }
+
+void GenePool::setNumThreads(size_t num) { p_->numThreads = std::max(size_t(1), num); }
+size_t GenePool::numThreads() const { return p_->numThreads; }
+void GenePool::setEvaluator(GeneEvaluator * e) { p_->evaluator = e; }
+GeneEvaluator * GenePool::evaluator() const { return p_->evaluator; }
+void GenePool::setEvaluationCache(bool enable) { p_->cache = enable; }
+uint64_t GenePool::numEvaluations() const { return p_->numEval; }
+uint64_t GenePool::numCacheHits() const { return p_->numCacheHits; }
+uint64_t GenePool::numChildren() const { return p_->numChildren; }
+uint64_t GenePool::numDuplicates() const { return p_->numDuplicates; }
+
+uint64_t GenePool::generation() const { return p_->generation; }
+
 void GenePool::nextGeneration()
 {
     if (p_->genes.empty())
         return;
 
-    const size_t
-            num = p_->genes.size(),
-    // number of individuals to reproduce
-            num_rep = num / 3;
+    ++p_->generation;
 
-    auto all = genes();
-    auto best = getBest(num_rep);
+    const Settings& set = p_->set;
 
-    p_->genes.clear();
+    // 1/5 success rule
+    if (set.adaptiveMutation && p_->numOffspring)
+    {
+        const double rate = double(p_->numImproved) / p_->numOffspring;
+        p_->mutationScale *= rate > ADAPT_SUCCESS ? ADAPT_FACTOR : 1. / ADAPT_FACTOR;
+        p_->mutationScale = std::max(.01, std::min(100., p_->mutationScale));
+    }
+    p_->numOffspring = p_->numImproved = 0;
 
-    // copy the very best
-    size_t num_cpy = std::min(best.size(), size_t(5));
-    for (size_t i = 0; i<num_cpy; ++i)
-        p_->genes.push_back(best[i]);
+    p_->clearHashes();
+    p_->updateIslands();
+    auto& islands = p_->islands;
 
-    // mutate the rest
-    while (p_->genes.size() < num)
+    if (islands.size() == 1)
     {
-        int i = rnd(0, int(best.size())-1);
-        auto g = best[i]->clone();
+        std::vector<std::shared_ptr<Gene>> next;
+        p_->breed(p_->whole, std::vector<std::shared_ptr<Gene>>(), next, true);
+        p_->genes.swap(next);
+        p_->invalidateRank();
+        return;
+    }
 
-        // cross-breed with someone
-        if (rnd_prob(.03))
+    // the best of each island go to the next one
+    std::vector<std::vector<std::shared_ptr<Gene>>> migrants(islands.size());
+    if (set.migrationInterval && p_->generation % set.migrationInterval == 0)
+        for (size_t i = 0; i < islands.size(); ++i)
         {
-#if 1
-            int j = rnd(0, int(best.size())-1);
-            g->cross(best[j].get());
-#else
-            int j = rnd(0, int(all.size())-1);
-            g->cross(all[j].get());
-#endif
+            auto& is = islands[i];
+            const size_t count = std::min(set.numMigrants, is.size() / 2);
+            p_->rankTop(is, count);
+            for (size_t j = 0; j < count; ++j)
+                migrants[(i + 1) % islands.size()].push_back(p_->genes[is.rank[j]]);
         }
-        else
-        // mutate
-        do
+
+    // each island allocates its genes on its own node
+    std::vector<std::vector<std::shared_ptr<Gene>>> next(islands.size());
+    std::vector<uint64_t> seeds;
+    for (size_t i = 0; i < islands.size(); ++i)
+        seeds.push_back(p_->mt());
+    p_->runIslands([&](size_t i)
+    {
+        std::mt19937_64 mt(seeds[i]);
+        threadRng = &mt;
+        p_->breed(islands[i], migrants[i], next[i], false);
+        threadRng = 0;
+    });
+
+    std::vector<std::shared_ptr<Gene>> genes;
+    genes.reserve(p_->genes.size());
+    for (auto& n : next)
+        genes.insert(genes.end(), n.begin(), n.end());
+    p_->genes.swap(genes);
+    p_->invalidateRank();
+}
+
+void GenePool::Private::breed(Island& is, const std::vector<std::shared_ptr<Gene>>& migrants,
+                              std::vector<std::shared_ptr<Gene>>& next, bool threaded)
+{
+    const size_t num = is.size();
+
+    // number of individuals to reproduce (ranked ones for truncation)
+    size_t num_rep = num, num_keep;
+    switch (set.selection)
+    {
+        case GS_TRUNCATION:
+            num_rep = std::max(size_t(1), std::min(num, size_t(num * set.truncation)));
+            rankTop(is, num_rep);
+        break;
+        case GS_RANK:
+            rankTop(is, num);
+        break;
+        default: break;
+    }
+
+    next.reserve(num);
+
+    if (set.selection == GS_STEADY_STATE)
+    {
+        // survivors, the rest of rank are the worst
+        num_keep = num - std::max(size_t(1), std::min(num, size_t(num * set.replaceFraction)));
+        rankTop(is, num_keep);
+    }
+    else
+    {
+        num_keep = std::min(num_rep, set.numElites);
+        // tournaments don't rank the genes by themselves
+        rankTop(is, num_keep);
+    }
+    num_keep = std::min(num_keep, num - std::min(num, migrants.size()));
+    // copy the very best
+    for (size_t i = 0; i<num_keep; ++i)
+    {
+        next.push_back(genes[is.rank[i]]);
+        insertHash(next.back()->hash());
+    }
+    // the immigrants, copied here to be local to this thread
+    for (size_t i = 0; i < migrants.size() && next.size() < num; ++i)
+    {
+        next.push_back(std::shared_ptr<Gene>(migrants[i]->clone()));
+        insertHash(next.back()->hash());
+    }
+
+    // create the rest
+    std::vector<Gene*> kids(num - next.size());
+    const size_t numThreads = threaded
+            ? std::min(this->numThreads, kids.size() / 16 + 1) : 1;
+    if (numThreads <= 1)
+    {
+        for (auto & k : kids)
+            k = createChild(is, num_rep);
+    }
+    else
+    {
+        // each thread gets a consecutive range of children
+        // and its own random generator seeded from the pool
+        std::vector<std::thread> threads;
+        std::vector<uint64_t> seeds;
+        for (size_t t = 0; t < numThreads; ++t)
+            seeds.push_back(mt());
+        for (size_t t = 0; t < numThreads; ++t)
+            threads.push_back(std::thread([&, t]()
+            {
+                std::mt19937_64 mt(seeds[t]);
+                threadRng = &mt;
+                for (size_t i = kids.size() * t / numThreads;
+                     i < kids.size() * (t + 1) / numThreads; ++i)
+                    kids[i] = createChild(is, num_rep);
+                threadRng = 0;
+            }));
+        for (auto & t : threads)
+            t.join();
+    }
+
+    for (auto k : kids)
+        next.push_back(std::shared_ptr<Gene>(k));
+}
+
+void GenePool::Private::updateIslands()
+{
+    const size_t num = std::max(size_t(1), std::min(set.numIslands, genes.size()));
+    whole.begin = 0;
+    whole.end = genes.size();
+    if (islands.size() == num && islands.back().end == genes.size())
+        return;
+
+    islands.resize(num);
+    for (size_t i = 0; i < num; ++i)
+    {
+        islands[i].begin = genes.size() * i / num;
+        islands[i].end = genes.size() * (i + 1) / num;
+        islands[i].numRanked = 0;
+    }
+}
+
+void GenePool::Private::runIslands(const std::function<void(size_t)>& work)
+{
+    const auto& nodes = numaNodes();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < islands.size(); ++i)
+        threads.push_back(std::thread([&, i]()
         {
-            g->mutate(rnd(0.0001, 0.5),
-                      rnd(0.0001, 0.1));
-        } while (*g == best[i].get());
+            // consecutive islands share a node
+            if (!nodes.empty())
+            {
+                const cpu_set_t& cpus = nodes[i * nodes.size() / islands.size()];
+                pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            }
+            work(i);
+        }));
+    for (auto& t : threads)
+        t.join();
+}
+
+size_t GenePool::Private::selectParent(Island& is, size_t num_rep)
+{
+    switch (set.selection)
+    {
+        case GS_TRUNCATION:
+            return is.rank[parent->rnd(0, int(num_rep)-1)];
 
-        ++g->p_gen_;
-        p_->genes.push_back(std::shared_ptr<Gene>(g));
+        case GS_RANK:
+        {
+            // inverse of the cumulative linear ranking distribution
+            const double s = std::max(1.000001, std::min(2., set.rankPressure)),
+                         u = parent->rnd();
+            const size_t i = is.size() * (s - std::sqrt(s * s - 4. * (s - 1.) * u))
+                                       / (2. * (s - 1.));
+            return is.rank[std::min(i, is.size() - 1)];
+        }
+
+        default:
+        {
+            size_t best = is.begin + parent->rnd(0, int(is.size())-1);
+            for (size_t i = 1; i < set.tournamentSize; ++i)
+            {
+                const size_t j = is.begin + parent->rnd(0, int(is.size())-1);
+                if (genes[j]->fitness() > genes[best]->fitness())
+                    best = j;
+            }
+            return best;
+        }
     }
 }
 
+Gene * GenePool::Private::createChild(Island& is, size_t num_rep)
+{
+    const Gene * par = genes[selectParent(is, num_rep)].get();
+    auto g = par->clone();
+
+    // cross-breed with someone or mutate
+    bool mutate = !parent->rnd_prob(set.crossProb), same = false;
+    if (!mutate)
+        g->cross(genes[selectParent(is, num_rep)].get());
 
+    // mutate again while the child equals its parent
+    // or another child, but without endlessly spinning
+    for (size_t tries = 0; ; )
+    {
+        if (mutate)
+            g->mutate(parent->rnd(set.mutateAmountMin, set.mutateAmountMax) * mutationScale,
+                      parent->rnd(set.mutateProbMin, set.mutateProbMax) * mutationScale);
+        same = mutate && *g == par;
+        if (!same)
+        {
+            ++numChildren;
+            if (insertHash(g->hash()))
+                break;
+            ++numDuplicates;
+            if (!set.rejectDuplicates)
+                break;
+        }
+        if (++tries >= set.maxMutateTries)
+            break;
+        mutate = true;
+    }
 
-Gene * GenePool::getBest() const
+    ++g->p_gen_;
+    g->p_pfit_ = par->p_fit_;
+    // an unchanged copy does not need another evaluation
+    g->p_eval_ = same && par->p_eval_;
+    return g;
+}
+
+bool GenePool::Private::insertHash(uint64_t hash)
 {
-    if (p_->genes.empty())
-        return 0;
+    // the low bits select the bucket within the shard
+    auto& shard = hashes[(hash >> 32) % NUM_HASH_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.set.insert(hash).second;
+}
+
+void GenePool::Private::clearHashes()
+{
+    for (auto& shard : hashes)
+        shard.set.clear();
+}
+
+
 
-    Gene * b = p_->genes[0].get();
-    double f = b->fitness();
+std::string GenePool::serialize() const
+{
+    std::string data(CHECKPOINT_MAGIC);
+    Gene::writeValue_(data, CHECKPOINT_VERSION);
+    Gene::writeValue_(data, p_->generation);
+    Gene::writeValue_(data, p_->numEval);
+    Gene::writeValue_(data, p_->numCacheHits);
+    Gene::writeValue_(data, p_->mutationScale);
+    Gene::writeValue_(data, p_->numOffspring);
+    Gene::writeValue_(data, p_->numImproved);
+
+    std::stringstream rng;
+    rng << p_->mt;
+    Gene::writeString_(data, rng.str());
+
+    Gene::writeValue_(data, uint64_t(p_->genes.size()));
+    std::string gene;
     for (auto & g : p_->genes)
-    if (g->fitness() > f)
     {
-        b = g.get();
-        f = b->fitness();
+        Gene::writeValue_(data, uint64_t(g->p_gen_));
+        Gene::writeValue_(data, g->p_fit_);
+        Gene::writeValue_(data, g->p_pfit_);
+        Gene::writeValue_(data, uint8_t(g->p_eval_));
+        gene.clear();
+        g->serialize(gene);
+        Gene::writeString_(data, gene);
+    }
+    return data;
+}
+
+bool GenePool::deserialize(const char * data, size_t size, const Gene& prototype)
+{
+    const char * end = data + size;
+    const size_t magic = sizeof(CHECKPOINT_MAGIC) - 1;
+    if (size < magic || std::string(data, magic) != CHECKPOINT_MAGIC)
+        return false;
+    data += magic;
+
+    uint32_t version;
+    uint64_t generation, numEval, numCacheHits, num,
+             numOffspring, numImproved;
+    double mutationScale;
+    std::string rng;
+    if (!Gene::readValue_(data, end, version)
+        || version != CHECKPOINT_VERSION
+        || !Gene::readValue_(data, end, generation)
+        || !Gene::readValue_(data, end, numEval)
+        || !Gene::readValue_(data, end, numCacheHits)
+        || !Gene::readValue_(data, end, mutationScale)
+        || !Gene::readValue_(data, end, numOffspring)
+        || !Gene::readValue_(data, end, numImproved)
+        || !Gene::readString_(data, end, rng)
+        || !Gene::readValue_(data, end, num))
+        return false;
+
+    std::mt19937_64 mt;
+    std::stringstream s(rng);
+    if (!(s >> mt))
+        return false;
+
+    std::vector<std::shared_ptr<Gene>> genes;
+    for (uint64_t i=0; i<num; ++i)
+    {
+        uint64_t gen;
+        double fit, pfit;
+        uint8_t eval;
+        uint32_t gsize;
+        if (!Gene::readValue_(data, end, gen)
+            || !Gene::readValue_(data, end, fit)
+            || !Gene::readValue_(data, end, pfit)
+            || !Gene::readValue_(data, end, eval)
+            || !Gene::readValue_(data, end, gsize)
+            || end - data < (std::ptrdiff_t)gsize)
+            return false;
+
+        std::shared_ptr<Gene> g(prototype.clone());
+        g->p_pool_ = this;
+        g->p_gen_ = gen;
+        g->p_fit_ = fit;
+        g->p_pfit_ = pfit;
+        g->p_eval_ = eval;
+        const char * gend = data + gsize;
+        if (!g->deserialize(data, gend) || data != gend)
+            return false;
+        genes.push_back(g);
     }
 
-    return b;
+    p_->genes.swap(genes);
+    p_->invalidateRank();
+    p_->mt = mt;
+    p_->generation = generation;
+    p_->numEval = numEval;
+    p_->numCacheHits = numCacheHits;
+    p_->mutationScale = mutationScale;
+    p_->numOffspring = numOffspring;
+    p_->numImproved = numImproved;
+    return true;
 }
 
-const std::vector<std::shared_ptr<Gene>> & GenePool::genes() const
+bool GenePool::Private::writeFile(const std::string& filename, const std::string& data)
 {
-    return p_->genes;
+    // a unique name in the same directory, so the rename stays
+    // on one file system and concurrent writers don't collide
+    std::vector<char> tmp(filename.begin(), filename.end());
+    const char suffix[] = ".XXXXXX";
+    tmp.insert(tmp.end(), suffix, suffix + sizeof(suffix));
+    const int fd = ::mkstemp(tmp.data());
+    if (fd < 0)
+        return false;
+    // mkstemp() creates the file for the owner only
+    ::fchmod(fd, 0644);
+
+    bool ok = true;
+    for (size_t pos = 0; ok && pos < data.size(); )
+    {
+        const ssize_t n = ::write(fd, data.data() + pos, data.size() - pos);
+        if (n > 0)
+            pos += n;
+        else
+            ok = false;
+    }
+    // make sure the data is on disk before the old file is replaced
+    ok &= ::fsync(fd) == 0;
+    ok &= ::close(fd) == 0;
+
+    if (!ok || ::rename(tmp.data(), filename.c_str()) != 0)
+    {
+        ::unlink(tmp.data());
+        return false;
+    }
+    return true;
 }
 
-std::vector<std::shared_ptr<Gene>> GenePool::getBest(size_t count) const
+bool GenePool::saveFile(const std::string& filename) const
 {
-    std::vector<std::shared_ptr<Gene>> best = genes();
+    // the file of a pending saveFileAsync() must not replace this one
+    if (p_->writer.joinable())
+        p_->writer.join();
+    return Private::writeFile(filename, serialize());
+}
 
-    std::stable_sort(best.begin(), best.end(),
-              [=](const std::shared_ptr<Gene>& l, const std::shared_ptr<Gene>& r)
+bool GenePool::saveFileAsync(const std::string& filename)
+{
+    if (p_->writing)
+        return false;
+    if (p_->writer.joinable())
+        p_->writer.join();
+
+    p_->writing = true;
+    auto p = p_;
+    const std::string data = serialize();
+    p_->writer = std::thread([p, filename, data]()
     {
-        return l->fitness() > r->fitness();
+        Private::writeFile(filename, data);
+        p->writing = false;
     });
+    return true;
+}
+
+bool GenePool::loadFile(const std::string& filename, const Gene& prototype)
+{
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void * data = ::mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    const bool ok = deserialize(static_cast<const char*>(data), st.st_size, prototype);
+    ::munmap(data, st.st_size);
+    return ok;
+}
+
+
+
+void GenePool::Private::rankTop(Island& is, size_t count)
+{
+    auto& rank = is.rank;
+    count = std::min(count, is.size());
+    if (rank.size() != is.size())
+    {
+        rank.resize(is.size());
+        is.numRanked = 0;
+    }
+    if (is.numRanked == 0)
+        for (size_t i = 0; i < rank.size(); ++i)
+            rank[i] = is.begin + i;
+    if (count <= is.numRanked)
+        return;
 
-    best.resize(std::min(best.size(), count));
+    auto cmp = [this](uint32_t l, uint32_t r) { return better(l, r); };
+    // the unsorted rest is never better than the sorted part
+    if (count == 1)
+        std::iter_swap(rank.begin(), std::min_element(rank.begin(), rank.end(), cmp));
+    else
+        std::partial_sort(rank.begin() + is.numRanked, rank.begin() + count,
+                          rank.end(), cmp);
+    is.numRanked = count;
+}
+
+std::vector<uint32_t> GenePool::Private::best(size_t count) const
+{
+    count = std::min(count, genes.size());
+    if (count <= whole.numRanked)
+        return std::vector<uint32_t>(whole.rank.begin(), whole.rank.begin() + count);
+
+    std::vector<uint32_t> rank(genes.size());
+    for (size_t i = 0; i < rank.size(); ++i)
+        rank[i] = i;
+    auto cmp = [this](uint32_t l, uint32_t r) { return better(l, r); };
+    std::partial_sort(rank.begin(), rank.begin() + count, rank.end(), cmp);
+    rank.resize(count);
+    return rank;
+}
+
+Gene * GenePool::getBest() const
+{
+    if (p_->genes.empty())
+        return 0;
+
+    return p_->genes[p_->best(1)[0]].get();
+}
+
+const std::vector<std::shared_ptr<Gene>> & GenePool::genes() const
+{
+    return p_->genes;
+}
+
+std::vector<std::shared_ptr<Gene>> GenePool::getBest(size_t count) const
+{
+    std::vector<std::shared_ptr<Gene>> best;
+    for (auto i : p_->best(count))
+        best.push_back(p_->genes[i]);
     return best;
 }
 
@@ -177,20 +872,26 @@ std::vector<std::shared_ptr<Gene>> GenePool::getBest(size_t count) const
 
 
 
+void GenePool::setSeed(uint64_t seed)
+{
+    p_->mt.seed(seed);
+}
+
 double GenePool::rnd()
 {
-    return double(p_->mt()) / p_->mt.max();
+    auto& mt = p_->rng();
+    return double(mt()) / mt.max();
 }
 
 double GenePool::rnd(double mi, double ma)
 {
-    return mi + rnd() / std::max(0.0000000001, ma - mi);
+    return mi + rnd() * (ma - mi);
 }
 
 int GenePool::rnd(int mi, int ma)
 {
     const int mo = std::max(1, ma - mi + 1);
-    return mi + int(uint64_t(p_->mt()) % uint64_t(mo));
+    return mi + int(uint64_t(p_->rng()()) % uint64_t(mo));
 }
 
 bool GenePool::rnd_prob(double prob)
@@ -13,14 +13,94 @@
 
 #include <iostream>
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <memory>
+#include <string>
 
 class Gene;
+class GeneEvaluator;
+
+/** How nextGeneration() selects parents */
+enum GeneSelection
+{
+    /** Uniformly from the best fraction of the population */
+    GS_TRUNCATION,
+    /** Best of a few random genes */
+    GS_TOURNAMENT,
+    /** Linear ranking, the probability falls with the rank */
+    GS_RANK,
+    /** Only the worst fraction is replaced, parents by tournament */
+    GS_STEADY_STATE
+};
 
 class GenePool
 {
 public:
+
+    /** Parameters of nextGeneration() */
+    struct Settings
+    {
+        Settings()
+            : selection         (GS_TRUNCATION)
+            , truncation        (1. / 3.)
+            , tournamentSize    (3)
+            , rankPressure      (1.5)
+            , replaceFraction   (.1)
+            , numElites         (5)
+            , crossProb         (.03)
+            // the ranges the original mutation parameters effectively had
+            , mutateAmountMin   (.0001)
+            , mutateAmountMax   (2.)
+            , mutateProbMin     (.0001)
+            , mutateProbMax     (10.)
+            , adaptiveMutation  (false)
+            , maxMutateTries    (16)
+            , rejectDuplicates  (true)
+            , numIslands        (1)
+            , migrationInterval (10)
+            , numMigrants       (2)
+        { }
+
+        GeneSelection selection;
+        /** Part of the population that reproduces with GS_TRUNCATION */
+        double truncation;
+        /** Number of genes per tournament with GS_TOURNAMENT and GS_STEADY_STATE */
+        size_t tournamentSize;
+        /** Expected offspring of the best gene with GS_RANK, in [1,2] */
+        double rankPressure;
+        /** Part of the population replaced with GS_STEADY_STATE */
+        double replaceFraction;
+        /** Number of best genes that are copied unchanged */
+        size_t numElites;
+        /** Probability of cross-breeding instead of mutation */
+        double crossProb;
+        /** Ranges of the parameters of Gene::mutate() */
+        double mutateAmountMin, mutateAmountMax,
+               mutateProbMin, mutateProbMax;
+        /** Scales the mutation ranges with the 1/5 success rule,
+            see mutationScale(). Works best with the generational
+            strategies, steady-state drives the scale down. */
+        bool adaptiveMutation;
+        /** Number of mutations tried until a child differs from the parent.
+            An unchanged child takes over the parent's fitness. */
+        size_t maxMutateTries;
+        /** Mutates children again whose Gene::hash() is already in the
+            next generation, so the evaluations go to distinct genes.
+            After maxMutateTries the duplicate is kept. With more than
+            one thread the result depends on the order of the threads. */
+        bool rejectDuplicates;
+        /** Number of parts of the population that are bred separately.
+            Each island is bred and evaluated by one thread that is
+            pinned to a NUMA node, consecutive islands share a node.
+            Genes are allocated by the thread of their island.
+            numThreads() is not used for more than one island. */
+        size_t numIslands;
+        /** Every this many generations, the numMigrants best genes
+            of each island replace the worst of the next island. */
+        size_t migrationInterval, numMigrants;
+    };
+
     GenePool();
     ~GenePool();
 
@@ -30,14 +110,95 @@ public:
 
     void initialize(const std::vector<Gene*>& genes);
 
+    /** Calls Gene::evaluate() for all genes */
     void evaluate();
 
     void nextGeneration();
 
+    /** Number of nextGeneration() calls since initialize() */
+    uint64_t generation() const;
+
+    // ------------- checkpoints ---------------
+
+    /** Returns the complete state in a versioned binary format:
+        genes with their fitness and generation, counters and
+        the state of the random generator. */
+    std::string serialize() const;
+
+    /** Restores a state from serialize().
+        Each gene is a clone() of @p prototype that is then deserialized.
+        Returns false for invalid data, the pool is unchanged then. */
+    bool deserialize(const char * data, size_t size, const Gene& prototype);
+
+    /** Writes serialize() to @p filename.
+        The data is written to a temporary file which is renamed
+        afterwards, so the file is either complete or the old one.
+        Waits for a pending saveFileAsync() first. */
+    bool saveFile(const std::string& filename) const;
+
+    /** Like saveFile() but writes in a background thread.
+        The state is copied before returning, so the pool can
+        be changed right away. Returns false without writing if
+        the previous write has not finished yet. */
+    bool saveFileAsync(const std::string& filename);
+
+    /** Restores a state from a file written by saveFile(),
+        the file is memory-mapped for reading. */
+    bool loadFile(const std::string& filename, const Gene& prototype);
+
+    // -------------- settings -----------------
+
+    void setSettings(const Settings& s);
+    const Settings& settings() const;
+
+    /** Current factor of the mutation ranges.
+        With Settings::adaptiveMutation, it grows when more than
+        a fifth of the mutated genes are at least as fit as their
+        parent and shrinks otherwise, it stays 1 without. */
+    double mutationScale() const;
+
+    /** Sets the number of threads used by evaluate() and
+        nextGeneration(), 1 by default.
+        Gene::evaluate() must be thread-safe for more than one thread.
+        Genes use per-thread random generators in nextGeneration()
+        then, so the results depend on the number of threads. */
+    void setNumThreads(size_t num);
+    size_t numThreads() const;
+
+    /** Lets evaluate() pass the genes to @p evaluator instead of
+        calling Gene::evaluate() in own threads, e.g. a
+        GeneProcessEvaluator. The pool does not take ownership,
+        NULL switches back to the threads. */
+    void setEvaluator(GeneEvaluator * evaluator);
+    GeneEvaluator * evaluator() const;
+
+    /** Lets evaluate() skip genes that did not change since their
+        last evaluation, e.g. the copied best ones.
+        This is only correct for a deterministic Gene::evaluate(),
+        so it is off by default. */
+    void setEvaluationCache(bool enable);
+
+    /** Number of Gene::evaluate() calls */
+    uint64_t numEvaluations() const;
+    /** Number of evaluations skipped because of setEvaluationCache() */
+    uint64_t numCacheHits() const;
+
+    /** Number of genes created by nextGeneration() that differ from
+        their parent, including the rejected duplicates */
+    uint64_t numChildren() const;
+    /** Number of created genes that were already in the next generation,
+        whether they were rejected (Settings::rejectDuplicates) or not.
+        Divided by numChildren() it is the duplicate rate. */
+    uint64_t numDuplicates() const;
+
     // ----------- selecting genes -------------
 
     const std::vector<std::shared_ptr<Gene>>& genes() const;
 
+    /** Returns the fittest gene, NULL for an empty pool.
+        evaluate() ranks the best genes, so after it this and
+        getBest(size_t) only copy the ranking. They never change
+        the pool, so several threads can query it at once. */
     Gene * getBest() const;
 
     /** Returns the best @p count number of individuals */
@@ -48,7 +209,13 @@ public:
 
     // ------ random functions for genes -------
 
-    /** Returns random number in [0,1) */
+    /** Seeds the random generator, e.g. for reproducible runs.
+        By default it is seeded from the system clock. */
+    void setSeed(uint64_t seed);
+
+    /** Returns random number in [0,1].
+        The functions use a per-thread generator while nextGeneration()
+        creates genes in several threads. */
     double rnd();
     double rnd(double mi, double ma);
     int rnd(int mi, int ma);
@@ -0,0 +1,118 @@
+/** @file genethread.cpp
+
+    @brief Runs the evolution of brainfuck programs in a background thread
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#include <chrono>
+
+#include "genethread.h"
+#include "genepool.h"
+#include "brainfgene.h"
+
+/** Milliseconds between published states */
+#define PUBLISH_INTERVAL 50
+
+GeneThread::GeneThread(QObject * parent)
+    : QThread   (parent)
+    , p_stop_   (false)
+{
+}
+
+GeneThread::~GeneThread()
+{
+    stop();
+    wait();
+}
+
+void GeneThread::startEvolution(const Settings& s)
+{
+    stop();
+    wait();
+
+    p_set_ = s;
+    p_stop_ = false;
+    start();
+}
+
+bool GeneThread::stats(Stats& stats)
+{
+    if (!p_stats_.update())
+        return false;
+    stats = p_stats_.front();
+    return true;
+}
+
+void GeneThread::run()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    GenePool pool;
+    pool.setNumThreads(p_set_.numThreads);
+    pool.setEvaluationCache(true);
+    {
+        std::vector<Gene*> genes;
+        for (size_t i=0; i<p_set_.population; ++i)
+        {
+            auto g = new BrainfGene();
+            g->setTarget(p_set_.target);
+            g->setMaxSteps(p_set_.maxSteps);
+            genes.push_back(g);
+        }
+        pool.initialize(genes);
+        pool.evaluate();
+    }
+
+    uint64_t gen = 0, lastGen = 0, lastEval = 0, lastHits = 0,
+             lastChildren = 0, lastDuplicates = 0;
+    auto last = Clock::now();
+
+    while (!p_stop_)
+    {
+        pool.nextGeneration();
+        pool.evaluate();
+        ++gen;
+
+        const auto now = Clock::now();
+        const double sec = std::chrono::duration<double>(now - last).count();
+        if (sec * 1000. < PUBLISH_INTERVAL)
+            continue;
+
+        Stats& s = p_stats_.back();
+        const uint64_t
+                eval = pool.numEvaluations(),
+                hits = pool.numCacheHits(),
+                children = pool.numChildren(),
+                duplicates = pool.numDuplicates();
+        s.generation = gen;
+        s.evaluations = eval;
+        s.generationsPerSec = (gen - lastGen) / sec;
+        s.evaluationsPerSec = (eval - lastEval) / sec;
+        s.cacheHitRate = double(hits - lastHits)
+                / std::max(uint64_t(1), eval - lastEval + hits - lastHits);
+        s.duplicateRate = double(duplicates - lastDuplicates)
+                / std::max(uint64_t(1), children - lastChildren);
+
+        double sum = 0.;
+        for (auto & g : pool.genes())
+            sum += g->fitness();
+        s.meanFitness = sum / std::max(size_t(1), pool.genes().size());
+        auto best = static_cast<BrainfGene*>(pool.getBest());
+        s.bestFitness = best->fitness();
+        s.best = best->toString();
+        s.bestCode = best->getBrainf().codeString();
+
+        p_stats_.publish();
+
+        last = now;
+        lastGen = gen;
+        lastEval = eval;
+        lastHits = hits;
+        lastChildren = children;
+        lastDuplicates = duplicates;
+    }
+}
@@ -0,0 +1,92 @@
+/** @file genethread.h
+
+    @brief Runs the evolution of brainfuck programs in a background thread
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#ifndef GENETHREAD_H
+#define GENETHREAD_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+#include <QThread>
+
+#include "triplebuffer.h"
+
+/** Breeds BrainfGene programs until stopped.
+
+    The state of the evolution is published a few times per second
+    through a TripleBuffer. The UI polls it with stats(), so there
+    are no queued signals and neither side waits for the other.
+*/
+class GeneThread : public QThread
+{
+    Q_OBJECT
+
+public:
+
+    /** Settings for one evolution */
+    struct Settings
+    {
+        Settings()
+            : target("brainf***"), population(100), numThreads(1), maxSteps(500) { }
+        /** Output that the programs should produce */
+        std::string target;
+        size_t population;
+        /** Threads for evaluating the genes */
+        size_t numThreads;
+        /** Step limit per program */
+        size_t maxSteps;
+    };
+
+    /** The published state */
+    struct Stats
+    {
+        Stats()
+            : generation(0), evaluations(0), generationsPerSec(0.),
+              evaluationsPerSec(0.), cacheHitRate(0.), duplicateRate(0.),
+              bestFitness(0.), meanFitness(0.) { }
+        uint64_t generation, evaluations;
+        double generationsPerSec, evaluationsPerSec,
+        /** Part of the evaluations skipped by the cache [0,1] */
+               cacheHitRate,
+        /** Part of the created genes that were already in the population [0,1] */
+               duplicateRate,
+               bestFitness, meanFitness;
+        /** Output and code of the best gene, and the code alone */
+        std::string best, bestCode;
+    };
+
+    explicit GeneThread(QObject * parent = 0);
+    /** Stops and waits for the thread */
+    ~GeneThread();
+
+    /** Starts a new evolution, a running one is stopped first */
+    void startEvolution(const Settings& s);
+
+    /** Requests the evolution to stop, returns immediately */
+    void stop() { p_stop_ = true; }
+
+    /** Takes the latest published state into @p stats.
+        Returns false if there is no new state since the last call.
+        Must only be called from one thread. */
+    bool stats(Stats& stats);
+
+protected:
+
+    void run() override;
+
+private:
+
+    Settings p_set_;
+    std::atomic<bool> p_stop_;
+    TripleBuffer<Stats> p_stats_;
+};
+
+#endif // GENETHREAD_H
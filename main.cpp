@@ -71,11 +71,12 @@ int testBf()
 }
 
 
-// Small endless evolutionary loop
+// Small endless evolutionary loop, resumes from breed.bfgp
 int breed()
 {
     GenePool pool;
 
+    if (!pool.loadFile("breed.bfgp", BrainfGene()))
     {
         std::vector<Gene*> genes;
         for (int i=0; i<100; ++i)
@@ -98,6 +99,7 @@ int breed()
         {
             std::cout << "\nGENERATION " << i << std::endl;
             pool.dump(20);
+            pool.saveFileAsync("breed.bfgp");
         }
     }
 
@@ -13,10 +13,36 @@
 #include <QTimer>
 #include <QFont>
 #include <QCheckBox>
+#include <QComboBox>
+#include <QSpinBox>
 #include <QLabel>
+#include <QTextCursor>
+#include <QTextEdit>
+#include <QPushButton>
+#include <QKeySequence>
+#include <QDockWidget>
+#include <QLineEdit>
+#include <QPainter>
+#include <QPolygonF>
+#include <QThread>
+
+#include <memory>
+#include <vector>
+#include <algorithm>
 
 #include "mainwindow.h"
-#include "brainf.h"
+#include "brainfthread.h"
+#include "brainfdebugger.h"
+#include "genethread.h"
+
+/** Number of steps per event loop cycle when the debugger runs */
+#define DEBUG_SLICE 100000
+/** Number of cells left and right of the pointer in the tape view */
+#define TAPE_VIEW_CELLS 8
+/** Milliseconds between polls of the evolution state */
+#define GENE_POLL_INTERVAL 100
+/** Maximum number of points in the fitness plot */
+#define MAX_PLOT_POINTS 1000
 
 struct MainWindow::Private
 {
@@ -24,21 +50,134 @@ struct MainWindow::Private
         : win           (win)
         , dataSize      (8)
         , signedData    (false)
+        , saturate      (false)
+        , numSteps      (1000000)
+        , runId         (0)
+        , debugStopAt   (-1)
     {
 
     }
 
     void createWidgets();
+    /** Starts running the program in the background */
     void run();
+    /** Appends text at the end of the output view */
+    void appendOutput(const QString& text);
+
+    /** Creates a debugger for the current code, input and cell type */
+    void startDebugger();
+    /** Leaves debug mode */
+    void stopDebugger();
+    /** Runs the debugger in slices until @p stopAt or a breakpoint */
+    void continueDebugger(int stopAt);
+    /** Shows the state of the debugger */
+    void updateDebugView();
+    /** Returns the opcode index at or after the text cursor */
+    int cursorOpcode() const;
+
+    /** Creates the evolution panel */
+    void createGeneDock();
+    /** Shows the latest state of the evolution */
+    void updateGeneView();
 
     MainWindow * win;
     QTimer * timer;
     QPlainTextEdit * editCode, * editInp, * editOut;
+    QLabel * status;
+    BrainfThread * thread;
 
+    /** Cell size in bits, 128 selects Brainf_bignum */
     int dataSize;
-    bool signedData;
+    bool signedData, saturate;
+    /** Step limit, 0 for unlimited */
+    int numSteps;
+    /** Id of the current run in thread */
+    int runId;
+
+    std::unique_ptr<BrainfDebuggerBase> debugger;
+    QTimer * debugTimer;
+    QLabel * tapeView;
+    /** Text position of each opcode in editCode while debugging */
+    std::vector<int> opPos;
+    /** Opcode index of 'run to cursor', or -1 */
+    int debugStopAt;
+
+    class FitnessPlot;
+
+    GeneThread * geneThread;
+    GeneThread::Stats geneStats;
+    QTimer * geneTimer;
+    QLabel * geneStatus;
+    QPlainTextEdit * geneBest;
+    FitnessPlot * genePlot;
+};
+
+/** Best and mean fitness over generations */
+class MainWindow::Private::FitnessPlot : public QWidget
+{
+public:
+    explicit FitnessPlot(QWidget * parent) : QWidget(parent) { setMinimumHeight(120); }
+
+    void clear() { p_gen_.clear(); p_best_.clear(); p_mean_.clear(); update(); }
+
+    void addPoint(double gen, double best, double mean)
+    {
+        p_gen_.push_back(gen);
+        p_best_.push_back(best);
+        p_mean_.push_back(mean);
+        // keep every second when full
+        if (p_gen_.size() > MAX_PLOT_POINTS)
+            for (auto v : { &p_gen_, &p_best_, &p_mean_ })
+            {
+                for (size_t i = 1; i < v->size() / 2; ++i)
+                    (*v)[i] = (*v)[i * 2];
+                v->resize(v->size() / 2);
+            }
+        update();
+    }
+
+protected:
+
+    void paintEvent(QPaintEvent *) override
+    {
+        QPainter p(this);
+        p.fillRect(rect(), QColor(0, 0, 0));
+        if (p_gen_.size() < 2)
+            return;
+
+        // fitness is in [0,100]
+        const double gmax = std::max(1., p_gen_.back());
+        auto curve = [&](const std::vector<double>& f, const QColor& color)
+        {
+            QPolygonF poly;
+            for (size_t i = 0; i < p_gen_.size(); ++i)
+                poly << QPointF(p_gen_[i] / gmax * (width() - 1),
+                                (1. - f[i] / 100.) * (height() - 1));
+            p.setPen(QPen(color));
+            p.drawPolyline(poly);
+        };
+        curve(p_mean_, QColor(80, 120, 255));
+        curve(p_best_, QColor(255, 220, 80));
+    }
+
+private:
+
+    std::vector<double> p_gen_, p_best_, p_mean_;
 };
 
+namespace {
+
+    template <typename T>
+    BrainfDebuggerBase * createDebugger(const std::string& code, const std::string& input)
+    {
+        Brainf<T> bf;
+        bf.setCode(code);
+        bf.setInput(input);
+        return new BrainfDebugger<T>(bf);
+    }
+
+} // namespace
+
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow   (parent)
@@ -46,6 +185,7 @@ MainWindow::MainWindow(QWidget *parent)
 {
     setMinimumSize(640, 640);
     p_->createWidgets();
+    p_->createGeneDock();
 }
 
 MainWindow::~MainWindow()
@@ -61,6 +201,28 @@ void MainWindow::Private::createWidgets()
     timer->setInterval(200);
     connect(timer, &QTimer::timeout, [=](){ run(); });
 
+    thread = new BrainfThread(win);
+    connect(thread, &BrainfThread::progress,
+            [=](int id, qulonglong steps, qulonglong outLen)
+    {
+        if (id == runId)
+            status->setText(tr("running... %1 steps, %2 output")
+                            .arg(steps).arg(outLen));
+    });
+    connect(thread, &BrainfThread::output, [=](int id, const QString& outp)
+    {
+        if (id == runId)
+            appendOutput(outp);
+    });
+    connect(thread, &BrainfThread::programFinished,
+            [=](int id, qulonglong steps, bool complete)
+    {
+        if (id != runId)
+            return;
+        status->setText(complete ? tr("finished after %1 steps").arg(steps)
+                                 : tr("step limit reached after %1 steps").arg(steps));
+    });
+
     auto w = new QWidget(win);
     win->setCentralWidget(w);
 
@@ -69,7 +231,15 @@ void MainWindow::Private::createWidgets()
         lv->addWidget(new QLabel(tr("code"), w) );
 
         editCode = new QPlainTextEdit(w);
-        connect(editCode, &QPlainTextEdit::textChanged, [=](){ timer->start(); });
+        connect(editCode, &QPlainTextEdit::textChanged, [=]()
+        {
+            // opcode positions are stale now
+            if (debugger)
+                stopDebugger();
+            // abort stale run right away
+            thread->cancel();
+            timer->start();
+        });
         lv->addWidget(editCode);
         // setup font
         // XXX monospace does not work for Mac
@@ -82,7 +252,13 @@ void MainWindow::Private::createWidgets()
         lv->addWidget(new QLabel(tr("input"), w) );
 
         editInp = new QPlainTextEdit(w);
-        connect(editInp, &QPlainTextEdit::textChanged, [=](){ timer->start(); });
+        connect(editInp, &QPlainTextEdit::textChanged, [=]()
+        {
+            if (debugger)
+                stopDebugger();
+            thread->cancel();
+            timer->start();
+        });
         lv->addWidget(editInp);
         // setup font
         editInp->setFont(f);
@@ -91,16 +267,20 @@ void MainWindow::Private::createWidgets()
         auto lh = new QHBoxLayout;
         lv->addLayout(lh);
 
-            auto cb = new QCheckBox(tr("8/16 bit"), w);
-            cb->setChecked(dataSize == 16);
-            connect(cb, &QCheckBox::stateChanged, [=]()
+            auto combo = new QComboBox(w);
+            for (int bits : { 8, 16, 32, 64 })
+                combo->addItem(tr("%1 bit").arg(bits), bits);
+            combo->addItem(tr("128 bit (bignum)"), 128);
+            combo->setCurrentIndex(combo->findData(dataSize));
+            connect(combo, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+                    [=]()
             {
-                dataSize = cb->isChecked() ? 16 : 8;
+                dataSize = combo->currentData().toInt();
                 run();
             });
-            lh->addWidget(cb);
+            lh->addWidget(combo);
 
-            cb = new QCheckBox(tr("signed"), w);
+            auto cb = new QCheckBox(tr("signed"), w);
             cb->setChecked(signedData);
             connect(cb, &QCheckBox::stateChanged, [=]()
             {
@@ -109,60 +289,393 @@ void MainWindow::Private::createWidgets()
             });
             lh->addWidget(cb);
 
+            cb = new QCheckBox(tr("saturate"), w);
+            cb->setChecked(saturate);
+            cb->setToolTip(tr("Stop at the cell limits instead of wrapping around"));
+            connect(cb, &QCheckBox::stateChanged, [=]()
+            {
+                saturate = cb->isChecked();
+                run();
+            });
+            lh->addWidget(cb);
+            // the bignum always wraps around
+            cb->setEnabled(dataSize != 128);
+            connect(combo, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+                    [=]() { cb->setEnabled(dataSize != 128); });
+
+            lh->addStretch();
+
+            lh->addWidget(new QLabel(tr("max. steps"), w));
+            auto sb = new QSpinBox(w);
+            sb->setRange(0, 2000000000);
+            sb->setSingleStep(100000);
+            sb->setSpecialValueText(tr("unlimited"));
+            sb->setValue(numSteps);
+            connect(sb, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+                    [=](int v)
+            {
+                numSteps = v;
+                timer->start();
+            });
+            lh->addWidget(sb);
+
+        // --- debugger ---
+
+        debugTimer = new QTimer(win);
+        debugTimer->setInterval(0);
+        connect(debugTimer, &QTimer::timeout, [=]()
+        {
+            if (!debugger
+                || debugger->run(DEBUG_SLICE, debugStopAt) < DEBUG_SLICE)
+                debugTimer->stop();
+            updateDebugView();
+        });
+
+        lh = new QHBoxLayout;
+        lv->addLayout(lh);
+
+            auto but = new QPushButton(tr("debug"), w);
+            but->setToolTip(tr("Start debugging at the first opcode"));
+            connect(but, &QPushButton::clicked, [=](){ startDebugger(); });
+            lh->addWidget(but);
+
+            but = new QPushButton(tr("stop"), w);
+            but->setToolTip(tr("Leave the debugger and run the program"));
+            connect(but, &QPushButton::clicked, [=]()
+            {
+                if (!debugger)
+                    return;
+                stopDebugger();
+                run();
+            });
+            lh->addWidget(but);
+
+            but = new QPushButton(tr("back"), w);
+            but->setShortcut(QKeySequence(Qt::SHIFT + Qt::Key_F10));
+            but->setToolTip(tr("Undo the last step (Shift+F10)"));
+            connect(but, &QPushButton::clicked, [=]()
+            {
+                if (!debugger)
+                    return;
+                debugTimer->stop();
+                debugger->stepBack();
+                updateDebugView();
+            });
+            lh->addWidget(but);
+
+            but = new QPushButton(tr("step"), w);
+            but->setShortcut(QKeySequence(Qt::Key_F10));
+            but->setToolTip(tr("Execute one opcode (F10)"));
+            connect(but, &QPushButton::clicked, [=]()
+            {
+                if (!debugger)
+                    startDebugger();
+                debugTimer->stop();
+                debugger->step();
+                updateDebugView();
+            });
+            lh->addWidget(but);
+
+            but = new QPushButton(tr("to cursor"), w);
+            but->setShortcut(QKeySequence(Qt::Key_F4));
+            but->setToolTip(tr("Run until the opcode at the text cursor (F4)"));
+            connect(but, &QPushButton::clicked, [=](){ continueDebugger(cursorOpcode()); });
+            lh->addWidget(but);
+
+            but = new QPushButton(tr("continue"), w);
+            but->setShortcut(QKeySequence(Qt::Key_F5));
+            but->setToolTip(tr("Run until a breakpoint (F5)"));
+            connect(but, &QPushButton::clicked, [=](){ continueDebugger(-1); });
+            lh->addWidget(but);
+
+            but = new QPushButton(tr("pause"), w);
+            connect(but, &QPushButton::clicked, [=](){ debugTimer->stop(); });
+            lh->addWidget(but);
+
+            but = new QPushButton(tr("breakpoint"), w);
+            but->setShortcut(QKeySequence(Qt::Key_F9));
+            but->setToolTip(tr("Toggle a breakpoint at the text cursor (F9)"));
+            connect(but, &QPushButton::clicked, [=]()
+            {
+                if (!debugger)
+                    startDebugger();
+                const int op = cursorOpcode();
+                debugger->setBreakpoint(op, !debugger->isBreakpoint(op));
+                updateDebugView();
+            });
+            lh->addWidget(but);
+
+            lh->addStretch();
+
+        tapeView = new QLabel(w);
+        tapeView->setFont(f);
+        tapeView->setTextFormat(Qt::RichText);
+        lv->addWidget(tapeView);
+
         lv->addWidget(new QLabel(tr("output"), w) );
 
         editOut = new QPlainTextEdit(w);
         editOut->setReadOnly(true);
+        // keep memory bounded for long output
+        editOut->setMaximumBlockCount(10000);
         lv->addWidget(editOut);
+
+        status = new QLabel(w);
+        lv->addWidget(status);
 }
 
 void MainWindow::Private::run()
 {
-    const int numSteps = 1000000;
-    std::string
+    BrainfThread::Settings set;
+    set.code = editCode->toPlainText().toStdString();
+    set.input = editInp->toPlainText().toStdString();
+    set.dataSize = dataSize;
+    set.signedData = signedData;
+    set.saturate = saturate;
+    set.maxSteps = numSteps;
+
+    runId = thread->startProgram(set);
+    editOut->clear();
+    status->setText(tr("running..."));
+}
+
+void MainWindow::Private::createGeneDock()
+{
+    geneThread = new GeneThread(win);
+
+    auto dock = new QDockWidget(tr("evolution"), win);
+    win->addDockWidget(Qt::RightDockWidgetArea, dock);
+    auto w = new QWidget(dock);
+    dock->setWidget(w);
+
+    auto lv = new QVBoxLayout(w);
+
+        lv->addWidget(new QLabel(tr("target output"), w));
+        auto target = new QLineEdit(w);
+        target->setText(QString::fromStdString(GeneThread::Settings().target));
+        lv->addWidget(target);
+
+        auto lh = new QHBoxLayout;
+        lv->addLayout(lh);
+
+            lh->addWidget(new QLabel(tr("population"), w));
+            auto pop = new QSpinBox(w);
+            pop->setRange(10, 100000);
+            pop->setValue(GeneThread::Settings().population);
+            lh->addWidget(pop);
+
+            lh->addWidget(new QLabel(tr("threads"), w));
+            auto threads = new QSpinBox(w);
+            threads->setRange(1, 256);
+            threads->setValue(std::max(1, QThread::idealThreadCount()));
+            lh->addWidget(threads);
+
+        lh = new QHBoxLayout;
+        lv->addLayout(lh);
+
+            auto but = new QPushButton(tr("start"), w);
+            connect(but, &QPushButton::clicked, [=]()
+            {
+                GeneThread::Settings s;
+                s.target = target->text().toStdString();
+                s.population = pop->value();
+                s.numThreads = threads->value();
+                geneThread->startEvolution(s);
+                genePlot->clear();
+                geneStatus->setText(tr("starting..."));
+                geneTimer->start();
+            });
+            lh->addWidget(but);
+
+            but = new QPushButton(tr("stop"), w);
+            connect(but, &QPushButton::clicked, [=]()
+            {
+                geneThread->stop();
+                geneTimer->stop();
+            });
+            lh->addWidget(but);
+
+            but = new QPushButton(tr("use best"), w);
+            but->setToolTip(tr("Copy the best program into the code editor"));
+            connect(but, &QPushButton::clicked, [=]()
+            {
+                if (!geneStats.bestCode.empty())
+                    editCode->setPlainText(QString::fromStdString(geneStats.bestCode));
+            });
+            lh->addWidget(but);
+
+        geneStatus = new QLabel(w);
+        lv->addWidget(geneStatus);
+
+        genePlot = new FitnessPlot(w);
+        lv->addWidget(genePlot);
+
+        geneBest = new QPlainTextEdit(w);
+        geneBest->setReadOnly(true);
+        lv->addWidget(geneBest);
+
+    // the ui polls, evolution never waits for it
+    geneTimer = new QTimer(win);
+    geneTimer->setInterval(GENE_POLL_INTERVAL);
+    connect(geneTimer, &QTimer::timeout, [=](){ updateGeneView(); });
+}
+
+void MainWindow::Private::updateGeneView()
+{
+    if (!geneThread->stats(geneStats))
+        return;
+
+    const auto& s = geneStats;
+    geneStatus->setText(tr("generation %1\n%2 gen/sec, %3 eval/sec\n"
+                           "cache hits %4%, duplicates %5%\nbest %6, mean %7")
+                        .arg(qulonglong(s.generation))
+                        .arg(s.generationsPerSec, 0, 'f', 1)
+                        .arg(s.evaluationsPerSec, 0, 'f', 0)
+                        .arg(s.cacheHitRate * 100., 0, 'f', 1)
+                        .arg(s.duplicateRate * 100., 0, 'f', 1)
+                        .arg(s.bestFitness, 0, 'f', 3)
+                        .arg(s.meanFitness, 0, 'f', 3));
+    genePlot->addPoint(s.generation, s.bestFitness, s.meanFitness);
+    geneBest->setPlainText(QString::fromStdString(s.best));
+}
+
+void MainWindow::Private::startDebugger()
+{
+    // ignore the running program
+    thread->cancel();
+    timer->stop();
+    debugTimer->stop();
+    runId = -1;
+
+    const std::string
             code = editCode->toPlainText().toStdString(),
-            inp = editInp->toPlainText().toStdString(),
-            outp;
+            input = editInp->toPlainText().toStdString();
 
-    if (dataSize == 8)
+    BrainfDebuggerBase * d = 0;
+    switch (dataSize)
     {
-        if (signedData)
-        {
-            Brainf_int8 bf;
-            bf.setCode(code);
-            bf.setInput(inp);
-            bf.run(numSteps);
-            outp = bf.outputString();
-        }
-        else
-        {
-            Brainf_uint8 bf;
-            bf.setCode(code);
-            bf.setInput(inp);
-            bf.run(numSteps);
-            outp = bf.outputString();
-        }
+        case 8:
+            if (saturate)
+                d = signedData ? createDebugger<Brainf_saturated<int8_t>>(code, input)
+                               : createDebugger<Brainf_saturated<u_int8_t>>(code, input);
+            else
+                d = signedData ? createDebugger<int8_t>(code, input)
+                               : createDebugger<u_int8_t>(code, input);
+        break;
+
+        case 16:
+            if (saturate)
+                d = signedData ? createDebugger<Brainf_saturated<int16_t>>(code, input)
+                               : createDebugger<Brainf_saturated<u_int16_t>>(code, input);
+            else
+                d = signedData ? createDebugger<int16_t>(code, input)
+                               : createDebugger<u_int16_t>(code, input);
+        break;
+
+        case 32:
+            if (saturate)
+                d = signedData ? createDebugger<Brainf_saturated<int32_t>>(code, input)
+                               : createDebugger<Brainf_saturated<u_int32_t>>(code, input);
+            else
+                d = signedData ? createDebugger<int32_t>(code, input)
+                               : createDebugger<u_int32_t>(code, input);
+        break;
+
+        case 64:
+            if (saturate)
+                d = signedData ? createDebugger<Brainf_saturated<int64_t>>(code, input)
+                               : createDebugger<Brainf_saturated<u_int64_t>>(code, input);
+            else
+                d = signedData ? createDebugger<int64_t>(code, input)
+                               : createDebugger<u_int64_t>(code, input);
+        break;
+
+        default:
+            d = createDebugger<Brainf_bignum>(code, input);
+        break;
     }
-    else
-    if (dataSize == 16)
+    debugger.reset(d);
+
+    // same filter as Brainf::setCode()
+    const QString text = editCode->toPlainText();
+    opPos.clear();
+    for (int i = 0; i < text.size(); ++i)
+        if (QString("<>+-,.[]").contains(text.at(i)))
+            opPos.push_back(i);
+
+    updateDebugView();
+}
+
+void MainWindow::Private::stopDebugger()
+{
+    debugTimer->stop();
+    debugger.reset();
+    opPos.clear();
+    editCode->setExtraSelections(QList<QTextEdit::ExtraSelection>());
+    tapeView->clear();
+}
+
+void MainWindow::Private::continueDebugger(int stopAt)
+{
+    if (!debugger)
+        startDebugger();
+    debugStopAt = stopAt;
+    debugTimer->start();
+}
+
+int MainWindow::Private::cursorOpcode() const
+{
+    return std::lower_bound(opPos.begin(), opPos.end(),
+                            editCode->textCursor().position()) - opPos.begin();
+}
+
+void MainWindow::Private::updateDebugView()
+{
+    if (!debugger)
+        return;
+
+    // current opcode and breakpoints
+    QList<QTextEdit::ExtraSelection> sel;
+    auto addSel = [&](int op, const QColor& color)
     {
-        if (signedData)
-        {
-            Brainf_int16 bf;
-            bf.setCode(code);
-            bf.setInput(inp);
-            bf.run(numSteps);
-            outp = bf.outputString();
-        }
-        else
-        {
-            Brainf_uint16 bf;
-            bf.setCode(code);
-            bf.setInput(inp);
-            bf.run(numSteps);
-            outp = bf.outputString();
-        }
+        if (op < 0 || op >= (int)opPos.size())
+            return;
+        QTextEdit::ExtraSelection s;
+        s.cursor = QTextCursor(editCode->document());
+        s.cursor.setPosition(opPos[op]);
+        s.cursor.setPosition(opPos[op] + 1, QTextCursor::KeepAnchor);
+        s.format.setBackground(color);
+        sel << s;
+    };
+    for (int i = 0; i < (int)opPos.size(); ++i)
+        if (debugger->isBreakpoint(i))
+            addSel(i, QColor(255, 128, 128));
+    addSel(debugger->programPosition(), QColor(255, 255, 128));
+    editCode->setExtraSelections(sel);
+
+    // cells around the pointer
+    QString tape;
+    const auto tp = debugger->tapePosition();
+    for (auto i = tp - TAPE_VIEW_CELLS; i <= tp + TAPE_VIEW_CELLS; ++i)
+    {
+        QString c = QString::fromStdString(debugger->cellString(i));
+        if (c.isEmpty())
+            c = "-";
+        tape += i == tp ? QString(" <b>[%1]</b>").arg(c) : QString(" %1").arg(c);
     }
+    tapeView->setText(tr("tape @%1:").arg(tp) + tape);
 
-    editOut->setPlainText(QString::fromStdString(outp));
+    editOut->setPlainText(QString::fromStdString(debugger->outputString()));
+
+    status->setText(debugger->isFinished()
+                    ? tr("debugging: finished after %1 steps").arg(qulonglong(debugger->steps()))
+                    : tr("debugging: step %1, opcode %2")
+                      .arg(qulonglong(debugger->steps())).arg(debugger->programPosition()));
+}
+
+void MainWindow::Private::appendOutput(const QString& text)
+{
+    QTextCursor c(editOut->textCursor());
+    c.movePosition(QTextCursor::End);
+    c.insertText(text);
 }
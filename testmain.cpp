@@ -0,0 +1,484 @@
+/** @file testmain.cpp
+
+    @brief Headless tests, no Qt dependency
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+/*  Each test prints what went wrong to std::cerr and returns false.
+    The program runs all tests, or the ones given by name as arguments,
+    and returns non-zero if any failed.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <random>
+#include <map>
+#include <cstdint>
+
+#include "brainf.h"
+#include "brainfcode.h"
+#include "brainfgene.h"
+#include "brainfscheduler.h"
+#include "genepool.h"
+
+namespace {
+
+// --------------------------- cell types -----------------------------
+
+/** Increments the largest and decrements the smallest value
+    with all engines, the cells must wrap around */
+template <typename T>
+bool checkWrap(const char * name)
+{
+    const T lo = std::numeric_limits<T>::min(),
+            hi = std::numeric_limits<T>::max();
+    bool ok = true;
+    for (int e = 0; e < BFE_NUM; ++e)
+    {
+        Brainf<T> bf;
+        bf.setEngine(BrainfEngine(e));
+        bf.setCode("+>-<");
+        bf.tapeAt(0) = hi;
+        bf.tapeAt(1) = lo;
+        const auto r = bf.run(100);
+        if (r.status != BFR_FINISHED || bf.cell(0) != lo || bf.cell(1) != hi)
+        {
+            std::cerr << name << " does not wrap around with the "
+                      << brainfEngineName(BrainfEngine(e)) << " engine" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool testWrap()
+{
+    return checkWrap<u_int8_t>("uint8")
+         & checkWrap<int8_t>("int8")
+         & checkWrap<u_int16_t>("uint16")
+         & checkWrap<int16_t>("int16")
+         & checkWrap<u_int32_t>("uint32")
+         & checkWrap<int32_t>("int32")
+         & checkWrap<u_int64_t>("uint64")
+         & checkWrap<int64_t>("int64");
+}
+
+
+// ---------------------------- scheduler -----------------------------
+
+/** Random code with balanced loops */
+std::string randomCode(std::mt19937& rng, size_t length)
+{
+    std::string code;
+    size_t depth = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        const int r = rng() % 10;
+        if (r == 0)
+        {
+            code += '[';
+            ++depth;
+        }
+        else if (r == 1 && depth)
+        {
+            code += ']';
+            --depth;
+        }
+        else
+            code += "<>+-,.,+"[rng() % 8];
+    }
+    return code.append(depth, ']');
+}
+
+/** Many random programs share a scheduler with a tiny quantum. Their
+    input arrives in chunks between turns and is closed at the end.
+    Each output must be the same as of an uninterrupted run() with the
+    whole input. One program is removed by the output callback, and
+    one reads the output of another one through the callbacks. */
+bool testScheduler()
+{
+    typedef BrainfScheduler<uint8_t> Scheduler;
+    typedef std::vector<uint8_t> Data;
+
+    struct Program
+    {
+        std::string input;
+        size_t fed;
+        Data expected, output;
+        int finished;
+    };
+    std::map<Scheduler::Id, Program> progs;
+
+    std::mt19937 rng(1);
+    auto randomInput = [&]()
+    {
+        std::string s(rng() % 20, ' ');
+        for (auto & c : s)
+            c = 'a' + rng() % 26;
+        return s;
+    };
+
+    Scheduler sched(7);
+    auto add = [&](const std::string& code, int engine, const std::string& input,
+                   const Data& expected)
+    {
+        Brainf<uint8_t> bf(16, 16, BFF_EXPAND_RIGHT | BFF_STOP_INFINITE);
+        bf.setEngine(BrainfEngine(engine % BFE_NUM));
+        bf.setCode(code);
+        const Scheduler::Id id = sched.add(bf);
+        progs[id] = Program{ input, 0, expected, Data(), 0 };
+        return id;
+    };
+    // output of an uninterrupted run, empty if it does not end
+    auto reference = [](const std::string& code, int engine, const std::string& input,
+                        bool * ends)
+    {
+        Brainf<uint8_t> bf(16, 16, BFF_EXPAND_RIGHT | BFF_STOP_INFINITE);
+        bf.setEngine(BrainfEngine(engine % BFE_NUM));
+        bf.setCode(code);
+        bf.setInput(input);
+        const auto r = bf.run(100000);
+        *ends = r.status == BFR_FINISHED || r.status == BFR_INFINITE;
+        return bf.output();
+    };
+
+    for (int i = 0; i < 300; ++i)
+    {
+        const std::string code = randomCode(rng, 5 + rng() % 40),
+                          input = randomInput();
+        bool ends;
+        const Data out = reference(code, i, input, &ends);
+        if (ends)
+            add(code, i, input, out);
+    }
+
+    // a filter whose output is the input of a second one
+    bool ends;
+    const std::string pipeInput = randomInput();
+    const Data pipeOut = reference(",[+.,]", 0, pipeInput, &ends);
+    const Scheduler::Id
+        pipeA = add(",[+.,]", 1, pipeInput, pipeOut),
+        pipeB = add(",[-.,]", 2, "", reference(",[-.,]", 2,
+                    Brainf<uint8_t>::toString(pipeOut), &ends));
+    // endless output until the callback removes it
+    const Scheduler::Id endless = add("+[.]", 3, "", Data());
+
+    sched.setOutputCallback([&](Scheduler::Id id, const Data& out)
+    {
+        Program & p = progs[id];
+        p.output.insert(p.output.end(), out.begin(), out.end());
+        if (id == pipeA)
+            sched.feed(pipeB, out);
+        if (id == endless && p.output.size() >= 100)
+            sched.remove(id);
+    });
+    sched.setFinishCallback([&](Scheduler::Id id, const Brainf<uint8_t>&)
+    {
+        ++progs[id].finished;
+        if (id == pipeA)
+            sched.closeInput(pipeB);
+    });
+
+    // feed a few characters to each program between turns
+    for (bool more = true; more; )
+    {
+        more = false;
+        for (auto & i : progs)
+        {
+            Program & p = i.second;
+            if (p.fed >= p.input.size())
+                continue;
+            const size_t n = std::min(size_t(rng() % 4), p.input.size() - p.fed);
+            sched.feed(i.first, p.input.substr(p.fed, n));
+            p.fed += n;
+            more = true;
+        }
+        sched.run(rng() % 300);
+    }
+    for (auto & i : progs)
+        if (i.first != pipeB)
+            sched.closeInput(i.first);
+    for (int i = 0; i < 1000 && !sched.isIdle(); ++i)
+        sched.run(100000);
+
+    bool ok = true;
+    if (sched.numPrograms() != 0)
+    {
+        std::cerr << sched.numPrograms() << " programs did not finish" << std::endl;
+        ok = false;
+    }
+    for (auto & i : progs)
+    {
+        const Program & p = i.second;
+        if (i.first == endless)
+        {
+            if (p.finished || p.output.size() < 100 || sched.contains(endless))
+            {
+                std::cerr << "removing a program in the output callback failed" << std::endl;
+                ok = false;
+            }
+        }
+        else if (p.finished != 1 || p.output != p.expected)
+        {
+            std::cerr << "program " << i.first << " finished " << p.finished
+                      << " times, output '" << Brainf<uint8_t>::toString(p.output)
+                      << "' instead of '" << Brainf<uint8_t>::toString(p.expected)
+                      << "'" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+
+// ---------------------------- gene code -----------------------------
+
+/** Edits code at random places. The hash, the bracket index and the
+    counts must be the same as for the code assigned in one piece, and
+    changes() must cover the edited opcodes and the places of erased ones. */
+bool testCode()
+{
+    std::mt19937 rng(1);
+    auto rnd = [&](size_t n) { return size_t(rng() % n); };
+
+    // the code with a flag for edited opcodes and for opcodes
+    // that got a new left neighbour, the last one is the end
+    struct Op { BrainfOpcode op; bool changed, seam; };
+    std::vector<Op> shadow(1, Op{ BFO_NOP, false, false });
+    auto shadowErase = [&](size_t pos)
+    {
+        shadow.erase(shadow.begin() + pos);
+        shadow[pos].seam = true;
+    };
+
+    BrainfCode code;
+    for (int i = 0; i < 5000; ++i)
+    {
+        const BrainfOpcode op = BrainfOpcode(BFO_LEFT + rnd(BFO_END - BFO_LEFT + 1)),
+                           body = BrainfOpcode(BFO_LEFT + rnd(BFO_BEGIN - BFO_LEFT));
+        const size_t pos = rnd(code.size() + 1);
+        switch (rnd(6))
+        {
+            case 0:
+                code.insert(pos, op);
+                shadow.insert(shadow.begin() + pos, Op{ op, true, false });
+            break;
+            case 1:
+                code.insertLoop(pos, body);
+                shadow.insert(shadow.begin() + pos, { Op{ BFO_BEGIN, true, false },
+                                                      Op{ body, true, false },
+                                                      Op{ BFO_END, true, false } });
+            break;
+            case 2:
+                if (pos < code.size())
+                {
+                    const size_t m = code.match(pos);
+                    code.erase(pos);
+                    if (m == BrainfCode::NO_MATCH)
+                        shadowErase(pos);
+                    else
+                    {
+                        shadowErase(std::max(pos, m));
+                        shadowErase(std::min(pos, m));
+                    }
+                }
+            break;
+            case 3:
+                if (pos < code.size())
+                {
+                    code.set(pos, op);
+                    shadow[pos] = Op{ op, true, false };
+                }
+            break;
+            case 4:
+            {
+                const size_t num = rnd(4);
+                code.erase(pos, num);
+                for (size_t j = 0; j < num && pos + 1 < shadow.size(); ++j)
+                    shadowErase(pos);
+            }
+            break;
+            case 5:
+                if (rnd(10) == 0)
+                    code.close();
+                if (rnd(10) == 0)
+                {
+                    code.setUnchanged();
+                    for (auto & o : shadow)
+                        o.changed = o.seam = false;
+                }
+            break;
+        }
+
+        std::vector<BrainfOpcode> ops;
+        for (size_t j = 0; j < code.size(); ++j)
+            ops.push_back(code[j]);
+        const BrainfCode whole(ops);
+        bool same = code.hash() == whole.hash()
+                 && shadow.size() == code.size() + 1;
+        for (int o = BFO_NOP; same && o <= BFO_END; ++o)
+            same = code.count(BrainfOpcode(o)) == whole.count(BrainfOpcode(o));
+        for (size_t j = 0; same && j < code.size(); ++j)
+            same = code.match(j) == whole.match(j) && code[j] == shadow[j].op;
+        for (size_t j = 0; same && j < shadow.size(); ++j)
+        if (shadow[j].changed || shadow[j].seam)
+        {
+            same = false;
+            for (auto & c : code.changes())
+                if (c.begin <= j && (j < c.end || (shadow[j].seam && j == c.end)))
+                    same = true;
+        }
+        if (!same)
+        {
+            std::cerr << "edited code differs from assigned code after "
+                      << i << " edits" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// ---------------------------- gene pool -----------------------------
+
+/** A pool of 50 genes with the same seed and settings each time */
+void createPool(GenePool& pool, const GenePool::Settings& set, const Gene& prototype)
+{
+    pool.setSeed(1);
+    pool.setNumThreads(1);
+    pool.setSettings(set);
+    std::vector<Gene*> genes;
+    for (int i = 0; i < 50; ++i)
+        genes.push_back(prototype.clone());
+    pool.initialize(genes);
+    pool.evaluate();
+}
+
+void breedPool(GenePool& pool, size_t generations)
+{
+    for (size_t i = 0; i < generations; ++i)
+    {
+        pool.nextGeneration();
+        pool.evaluate();
+    }
+}
+
+/** Breeds with each selection and adaptive mutation, once straight
+    through and once with a serialize() and deserialize() into a new
+    pool halfway. Both must end in the same state. */
+bool testResume()
+{
+    BrainfGene prototype;
+    prototype.setTarget("Hi!");
+    bool ok = true;
+    for (auto sel : { GS_TRUNCATION, GS_TOURNAMENT, GS_RANK, GS_STEADY_STATE })
+    {
+        GenePool::Settings set;
+        set.selection = sel;
+        set.adaptiveMutation = true;
+
+        GenePool straight, first, resumed;
+        createPool(straight, set, prototype);
+        breedPool(straight, 20);
+
+        createPool(first, set, prototype);
+        breedPool(first, 10);
+        const std::string data = first.serialize();
+        resumed.setSeed(1);
+        resumed.setNumThreads(1);
+        resumed.setSettings(set);
+        if (!resumed.deserialize(data.data(), data.size(), prototype))
+        {
+            std::cerr << "can not deserialize the pool, selection "
+                      << int(sel) << std::endl;
+            ok = false;
+            continue;
+        }
+        breedPool(resumed, 10);
+
+        if (resumed.serialize() != straight.serialize())
+        {
+            std::cerr << "resumed pool differs, selection " << int(sel) << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/** Tournaments do not rank the genes, but the elites are still
+    the best ones and the best fitness never drops */
+bool testTournament()
+{
+    BrainfGene prototype;
+    prototype.setTarget("Hi!");
+    GenePool::Settings set;
+    set.selection = GS_TOURNAMENT;
+    GenePool pool;
+    createPool(pool, set, prototype);
+
+    double best = pool.getBest()->fitness();
+    for (int i = 0; i < 30; ++i)
+    {
+        breedPool(pool, 1);
+        const double f = pool.getBest()->fitness();
+        if (f < best)
+        {
+            std::cerr << "best fitness dropped from " << best << " to " << f
+                      << " in generation " << pool.generation() << std::endl;
+            return false;
+        }
+        best = f;
+    }
+    return true;
+}
+
+
+// ------------------------------ main --------------------------------
+
+typedef bool (*TestFunc)();
+
+struct Test
+{
+    const char * name;
+    TestFunc func;
+};
+
+const Test tests[] =
+{
+    { "wrap",       testWrap },
+    { "scheduler",  testScheduler },
+    { "code",       testCode },
+    { "resume",     testResume },
+    { "tournament", testTournament },
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> names(argv + 1, argv + argc);
+    int failed = 0, num = 0;
+    for (auto & t : tests)
+    {
+        if (!names.empty()
+            && std::find(names.begin(), names.end(), t.name) == names.end())
+            continue;
+        ++num;
+        if (t.func())
+            std::cout << "ok     " << t.name << std::endl;
+        else
+        {
+            std::cout << "FAILED " << t.name << std::endl;
+            ++failed;
+        }
+    }
+    std::cout << num - failed << " of " << num << " tests passed" << std::endl;
+    return failed ? 1 : 0;
+}
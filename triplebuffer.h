@@ -0,0 +1,68 @@
+/** @file triplebuffer.h
+
+    @brief Lock-free exchange of the latest value between two threads
+
+    <p>(c) 2015, stefan.berke@modular-audio-graphics.com</p>
+    <p>All rights reserved</p>
+
+    <p>created 10/19/2026</p>
+*/
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/** Three instances of T shared by one writer and one reader thread.
+
+    The writer fills back() and publishes it, the reader takes the
+    latest published one with update() and reads front(). Each side
+    owns one buffer, the third is swapped atomically, so neither side
+    ever waits for the other. Values published in between two
+    update() calls are skipped.
+*/
+template <typename T>
+class TripleBuffer
+{
+public:
+
+    TripleBuffer() : p_middle_(1), p_back_(0), p_front_(2) { }
+
+    // ------------- writer ----------------
+
+    /** The buffer to write to */
+    T& back() { return p_buf_[p_back_]; }
+
+    /** Makes back() the latest value. The new back() contains an
+        older value, which the writer may reuse or overwrite. */
+    void publish()
+    {
+        p_back_ = p_middle_.exchange(p_back_ | NEW, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // ------------- reader ----------------
+
+    /** Makes the latest published value the front(),
+        returns false if nothing was published since the last call. */
+    bool update()
+    {
+        if (!(p_middle_.load(std::memory_order_relaxed) & NEW))
+            return false;
+        p_front_ = p_middle_.exchange(p_front_, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    /** The buffer to read from */
+    const T& front() const { return p_buf_[p_front_]; }
+
+private:
+
+    enum { INDEX = 3, NEW = 4 };
+
+    T p_buf_[3];
+    /** Index of the buffer in the middle, with NEW when it was published */
+    std::atomic<int> p_middle_;
+    int p_back_, p_front_;
+};
+
+#endif // TRIPLEBUFFER_H